@@ -0,0 +1,118 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <gsl/span>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read only cartridge ROM contents. ROMs opened from a file are memory mapped, so emulator
+// instances sharing a Rom (or processes mapping the same file) don't duplicate it in memory.
+class Rom {
+public:
+    // Take ownership of ROM data. It's padded with zeros to a whole number of banks, at least 32 KiB.
+    explicit Rom(std::vector<uint8_t> data);
+    ~Rom();
+
+    Rom(const Rom&) = delete;
+    Rom& operator=(const Rom&) = delete;
+
+    // Memory map ROM file.
+    static std::shared_ptr<const Rom> open(const std::string& path);
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    Rom() = default;
+
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    std::vector<uint8_t> buffer; // Used when ROM is not memory mapped
+    bool isMapped = false;
+};
+
+enum class Mbc {
+    None,
+    Mbc1,
+    Mbc3,
+    Mbc5
+};
+
+// Cartridge with a memory bank controller, which switches ROM and RAM banks visible to the CPU.
+class Cartridge {
+public:
+    static constexpr size_t romBankSize = 0x4000;
+    static constexpr size_t ramBankSize = 0x2000;
+    static constexpr size_t maxRamBanks = 16;
+
+    // Bank controller registers and RAM contents.
+    struct State {
+        uint64_t headerHash; // Identifies the cartridge the state was saved from
+        bool isRamEnabled;
+        uint16_t romBankRegister;
+        uint8_t ramBankRegister;
+        bool isRamBankingMode;
+        uint32_t ramSize;
+        std::array<uint8_t, maxRamBanks * ramBankSize> ram;
+    };
+
+    // Empty 32 KiB ROM without a memory bank controller.
+    Cartridge();
+
+    explicit Cartridge(std::shared_ptr<const Rom> rom);
+
+    Mbc getMbc() const { return mbc; }
+
+    // ROM bank mapped at 0x0000-0x3FFF.
+    const uint8_t* getRomBank0() const { return rom->data() + romBank0 * romBankSize; }
+
+    // ROM bank mapped at 0x4000-0x7FFF.
+    const uint8_t* getRomBank() const { return rom->data() + romBank * romBankSize; }
+
+    // Numbers of the ROM banks mapped at 0x0000-0x3FFF and 0x4000-0x7FFF.
+    size_t getRomBank0Number() const { return romBank0; }
+    size_t getRomBankNumber() const { return romBank; }
+
+    // RAM bank mapped at 0xA000-0xBFFF, nullptr if cartridge has no RAM or it is disabled.
+    uint8_t* getRamBank();
+
+    // Write to memory bank controller register at 0x0000-0x7FFF.
+    void write(uint16_t address, uint8_t value);
+
+    // External RAM of all banks.
+    gsl::span<const uint8_t> getRam() const { return ram; }
+
+    // Copy state into state. Without RAM, state.ram is left unchanged.
+    void saveState(State& state, bool withRam = true) const;
+
+    // Restore state saved from a cartridge with the same ROM header.
+    void loadState(const State& state);
+
+private:
+    std::shared_ptr<const Rom> rom;
+    uint64_t headerHash = 0; // Hash of ROM header at 0x0100-0x014F
+    std::vector<uint8_t> ram;
+    Mbc mbc = Mbc::None;
+    size_t romBanks = 2;
+    size_t ramBanks = 0;
+
+    // Memory bank controller registers.
+    bool isRamEnabled = false;
+    uint16_t romBankRegister = 1;
+    uint8_t ramBankRegister = 0;
+    bool isRamBankingMode = false; // MBC1 only
+
+    // Resolved bank numbers.
+    size_t romBank0 = 0;
+    size_t romBank = 1;
+    size_t ramBank = 0;
+
+    // Compute bank numbers from registers.
+    void updateBanks();
+};
+
+#endif // CARTRIDGE_H
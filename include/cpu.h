@@ -1,24 +1,68 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include "jit.h"
 #include "mmu.h"
 #include "timer.h"
 #include "utils.h"
 
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <vector>
 
-#include <json.hpp>
+enum class StopReason {
+    Budget, // Cycle budget used up
+    Breakpoint, // PC reached breakpoint, the instruction at it was not executed
+    UnimplementedOpcode
+};
+
+// Last operation setting flags N and H, from which they are derived when F is read.
+enum class FlagOp : uint8_t {
+    None, // N and H are stored in F
+    Add, // x + y
+    Compare, // x - y
+    Inc, // x + 1
+    Dec, // x - 1
+    AddHL // 16 bit x + y
+};
+
+struct RunResult {
+    uint64_t cycles; // May exceed the budget by the length of the last instruction
+    uint64_t instructions; // Includes skipped iterations of idle loops
+    StopReason reason;
+};
 
 class Cpu {
 public:
+    // Registers and interrupt state, with all flags evaluated.
+    struct State {
+        uint16_t af, bc, de, hl, sp, pc;
+        bool ime;
+        bool isImeDelayed; // imeDelayed has a value
+        bool imeDelayed;
+        bool isHalted;
+    };
+
     Cpu(Mmu& mmu, Timer& timer);
 
     // Execute next instruction.
     bool execute();
 
+    // Execute instructions until cycleBudget cycles have passed, PC reaches breakpoint
+    // or an unimplemented opcode is found. Only the CPU changes memory during the run, so time
+    // spent halted or in a loop polling memory is skipped to the end of the budget.
+    RunResult run(uint64_t cycleBudget, std::optional<uint16_t> breakpoint = {});
+
+    // Compile frequently run ROM code to host machine code used by run(), unless a breakpoint is set.
+    // Returns false if the host isn't supported, the interpreter is used then.
+    bool setJitEnabled(bool enabled);
+
+    // False if the JIT was never enabled, or turned itself off after running out of code memory.
+    bool isJitEnabled() const { return jit != nullptr; }
+
     // Get string representation of cpu state.
     std::string toString() const;
 
@@ -33,8 +77,23 @@ public:
     // Set value of AF register to nn.
     void setAF(uint16_t nn);
 
+    // Copy state into state.
+    void saveState(State& state) const;
+
+    // Restore state. Memory must be restored first, as decoded code is checked against it.
+    void loadState(const State& state);
+
     // Get flag value from F register.
-    bool getFlag(uint8_t flag) const;
+    bool getFlag(uint8_t flag) const
+    {
+        if (flag == flagZ) {
+            return zeroResult == 0;
+        }
+        if (flag == flagC) {
+            return carry;
+        }
+        return getF() & flag;
+    }
 
     static const uint8_t flagZ = 1 << 7;
     static const uint8_t flagN = 1 << 6;
@@ -44,7 +103,7 @@ public:
 private:
     union {
         struct {
-            uint8_t f; // Status flags
+            uint8_t f; // Status flags, only valid in low nibble and for N and H when flagOp is None
             uint8_t a; // Accumulator
         };
         uint16_t af;
@@ -80,23 +139,144 @@ private:
 
     bool ime = 0; // Interrupt Master Enable Flag
     std::optional<bool> imeDelayed = 0; // Interrupt Master Enable Flag - if set, sets ime after 1 instruction
+    bool isHalted = false; // HALT executed, waiting for an interrupt
+
+    // Loop closed by a JR which only reloads A from memory and tests it, so it spins until
+    // something else changes memory.
+    struct IdleLoop {
+        uint16_t end = 0; // Address after the JR
+        unsigned cycles = 0; // Cycles of one iteration, 0 if the loop isn't idle
+        unsigned instructions = 0; // Instructions of one iteration
+    };
+
+    // Last jump found not to close an idle loop, so busy loops aren't examined on every iteration.
+    // If the code changes, the loop is only run instead of being skipped.
+    int nonIdleJump = -1;
+
+    // Flags are evaluated lazily. Conditions only test Z and C, so they are kept ready to use, while
+    // N and H, which are rarely read, are derived from the operands of the last operation only when
+    // F is read by PUSH AF or getAF().
+    uint8_t zeroResult = 1; // Flag Z is set if this is 0
+    bool carry = false;
+    FlagOp flagOp = FlagOp::None;
+    uint16_t flagX = 0;
+    uint16_t flagY = 0;
 
     Timer& timer;
     Mmu& mmu;
 
-    // Set flag in register f to b.
-    void setFlag(uint8_t flag, bool b);
+    // Get F register with all flags evaluated.
+    uint8_t getF() const;
+
+    // Record operation from which N and H are derived.
+    void setFlagOp(FlagOp op, uint16_t x, uint16_t y = 0)
+    {
+        flagOp = op;
+        flagX = x;
+        flagY = y;
+    }
+
+    // Set N and H to values.
+    void setFlagsNH(uint8_t values)
+    {
+        f = static_cast<uint8_t>((f & ~(flagN | flagH)) | values);
+        flagOp = FlagOp::None;
+    }
+
+    // Flag if condition is true, otherwise 0. Flags of an operation are composed from these without branching.
+    static constexpr uint8_t flagIf(bool condition, uint8_t flag) { return static_cast<uint8_t>(-static_cast<int>(condition) & flag); }
 
     // Run Interrupt Service Routine if requested by interrupt flag.
     void handleInterrupts();
 
-    // Run CB prefixed instruction.
-    bool executeExtended();
+    // Return true if an enabled interrupt is requested, regardless of ime.
+    bool isInterruptPending() const;
+
+    // Get idle loop closed by the jump from jumpAddress to pc, cycles is 0 if it isn't one.
+    IdleLoop findIdleLoop(uint16_t jumpAddress) const;
 
-    // Read next byte.
+    // Instruction handler, called after opcode bytes have been read.
+    using Handler = void (*)(Cpu& cpu);
+
+    // Decoded opcode: handler, instruction length in bytes and base cycle count.
+    struct Opcode {
+        Handler execute;
+        uint8_t length;
+        uint8_t cycles = 0; // Filled in from opcodeCycles
+    };
+
+    // Dispatch tables for unprefixed and CB prefixed opcodes, built at compile time.
+    // Unimplemented opcodes have no handler.
+    static const std::array<Opcode, 256> opcodes;
+    static const std::array<Opcode, 256> extendedOpcodes;
+
+    static constexpr std::array<Opcode, 256> makeOpcodes();
+    static constexpr std::array<Opcode, 256> makeExtendedOpcodes();
+
+    // Instruction decoded ahead of execution.
+    struct DecodedInstruction {
+        Handler execute; // nullptr if opcode is unimplemented
+        uint16_t address;
+        uint8_t opcodeLength; // 2 for CB prefixed opcodes
+        uint8_t cycles;
+        std::array<uint8_t, 2> operands; // Bytes following the opcode
+    };
+
+    // Straight line code decoded once and reused until the memory it was decoded from changes.
+    struct Block {
+        const uint8_t* page = nullptr; // Memory mapped at the block when it was decoded
+        uint32_t version = 0; // Code version of the page when it was decoded
+        std::vector<DecodedInstruction> instructions;
+        JitFunction compiled = nullptr; // Runs the first compiledLength instructions
+        uint32_t compiledLength = 0;
+        bool isCompilable = true; // False if it starts with an instruction compiled code doesn't run
+        unsigned entries = 0; // Times run() reached the block while it wasn't compiled
+    };
+
+    // Blocks starting at each address of ROM (0x0000-0x7FFF) and work RAM (0xC000-0xDFFF), other
+    // code is decoded every time it is executed. Blocks don't cross pages, so writes to work RAM
+    // are tracked per page by Mmu. ROM blocks are kept per bank, allocated when code in the bank
+    // first runs, so switching banks back and forth reuses decoded and compiled code.
+    std::vector<std::vector<std::unique_ptr<Block>>> romBlocks;
+    std::vector<std::unique_ptr<Block>> ramBlocks;
+
+    // Position in the block being executed, it's left when PC doesn't match the next instruction
+    // or when the code epoch changes.
+    const DecodedInstruction* nextInstruction = nullptr;
+    const DecodedInstruction* blockEnd = nullptr;
+    uint32_t blockEpoch = 0;
+
+    DecodedInstruction uncachedInstruction;
+    const uint8_t* operand = nullptr; // Next operand byte of the executing instruction
+
+    // Compiled ROM code, nullptr if the JIT is disabled.
+    std::unique_ptr<JitCompiler> jit;
+    JitContext jitContext{};
+
+    // Get instruction at pc, decoded ahead if possible.
+    const DecodedInstruction& fetch();
+
+    // Get block starting at address, decoded again if memory changed. nullptr outside ROM and work RAM.
+    Block* getBlock(uint16_t address);
+
+    // Drop compiled code of all blocks, they are compiled again once run often enough.
+    void clearCompiled();
+
+    // Execute compiled block at pc if there is one, instructions starting before end are run.
+    // Returns number of instructions executed, 0 if the interpreter has to execute the next one.
+    // lastPC is set to the address of the last instruction executed.
+    uint32_t runCompiled(uint64_t end, uint16_t& lastPC);
+
+    // Decode instruction at address.
+    DecodedInstruction decode(uint16_t address) const;
+
+    // Decode block from start up to an unconditional jump or the end of the page.
+    std::unique_ptr<Block> decodeBlock(uint16_t start);
+
+    // Read next operand byte.
     uint8_t read();
 
-    // Read next 2 bytes.
+    // Read next 2 operand bytes.
     uint16_t read16();
 
     // Decrement reg.
@@ -132,17 +312,19 @@ private:
     // SWAP - Swap upper and lower nibbles of reg.
     void swap(uint8_t& reg);
 
+    // Conditional control flow helpers add takenCycles (see opcodeCycles) to the timer when the branch is taken.
+
     // JR n, JR cc,n - add n to current address and jump to it, if condition is met.
-    void relativeJump(bool condition);
+    void relativeJump(bool condition, int takenCycles = 0);
 
     // JP nn, JP cc,nn - jump to nn, if condition is met.
-    void jump(bool condition);
+    void jump(bool condition, int takenCycles = 0);
 
     // CALL nn, CALL cc, nn - push address of next instruction onto stack and then jump to address nn, if condition is met.
-    void call(bool condition);
+    void call(bool condition, int takenCycles = 0);
 
     // RET, RET cc - pop two bytes from the stack and jump to that address, if condition is met.
-    void ret(bool condition);
+    void ret(bool condition, int takenCycles = 0);
 
     // RST n - push pc to stack and jump to target.
     void rst(uint16_t target);
@@ -1,8 +1,70 @@
 #ifndef CYCLES_H
 #define CYCLES_H
 
+#include <array>
 #include <stdint.h>
 
-int getCycles(uint8_t opcode, uint8_t cbopcode, bool z, bool c);
+// Instruction timing in clock cycles.
+struct Cycles {
+    uint8_t base; // Cycles of an unconditional instruction, or of a conditional one when the branch is not taken
+    uint8_t taken; // Additional cycles when a conditional branch is taken
+};
+
+// clang-format off
+// Timing of unprefixed opcodes, indexed by opcode. Illegal opcodes take 0 cycles.
+constexpr std::array<Cycles, 256> opcodeCycles = { {
+//  x0       x1       x2        x3       x4        x5       x6       x7       x8       x9       xA        xB       xC        xD       xE       xF
+    {4, 0},  {12, 0}, {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {20, 0}, {8, 0},  {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 0x
+    {4, 0},  {12, 0}, {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {12, 0}, {8, 0},  {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 1x
+    {8, 4},  {12, 0}, {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {8, 4},  {8, 0},  {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 2x
+    {8, 4},  {12, 0}, {8, 0},   {8, 0},  {12, 0},  {12, 0}, {12, 0}, {4, 0},  {8, 4},  {8, 0},  {8, 0},   {8, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 3x
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 4x
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 5x
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 6x
+    {8, 0},  {8, 0},  {8, 0},   {8, 0},  {8, 0},   {8, 0},  {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 7x
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 8x
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // 9x
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // Ax
+    {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  {4, 0},  {4, 0},  {4, 0},   {4, 0},  {4, 0},   {4, 0},  {8, 0},  {4, 0},  // Bx
+    {8, 12}, {12, 0}, {12, 4},  {16, 0}, {12, 12}, {16, 0}, {8, 0},  {16, 0}, {8, 12}, {16, 0}, {12, 4},  {4, 0},  {12, 12}, {24, 0}, {8, 0},  {16, 0}, // Cx
+    {8, 12}, {12, 0}, {12, 4},  {0, 0},  {12, 12}, {16, 0}, {8, 0},  {16, 0}, {8, 12}, {16, 0}, {12, 4},  {0, 0},  {12, 12}, {0, 0},  {8, 0},  {16, 0}, // Dx
+    {12, 0}, {12, 0}, {8, 0},   {0, 0},  {0, 0},   {16, 0}, {8, 0},  {16, 0}, {16, 0}, {4, 0},  {16, 0},  {0, 0},  {0, 0},   {0, 0},  {8, 0},  {16, 0}, // Ex
+    {12, 0}, {12, 0}, {8, 0},   {4, 0},  {0, 0},   {16, 0}, {8, 0},  {16, 0}, {12, 0}, {8, 0},  {16, 0},  {4, 0},  {0, 0},   {0, 0},  {8, 0},  {16, 0}, // Fx
+} };
+// clang-format on
+
+// Timing of CB prefixed opcodes, indexed by the byte following the prefix. Includes the prefix itself.
+constexpr std::array<uint8_t, 256> extendedOpcodeCycles = [] {
+    std::array<uint8_t, 256> cycles{};
+    for (auto opcode = 0u; opcode < cycles.size(); ++opcode) {
+        bool isIndirect = (opcode & 0x7) == 0x6; // Operand is (HL)
+        bool isBit = opcode >= 0x40 && opcode < 0x80; // BIT n,(HL) only reads memory
+        cycles[opcode] = !isIndirect ? 8 : isBit ? 12 : 16;
+    }
+    return cycles;
+}();
+
+// Unconditional control flow takes as long as its conditional counterpart when taken.
+static_assert(opcodeCycles[0x18].base == opcodeCycles[0x20].base + opcodeCycles[0x20].taken, "JR n / JR cc,n");
+static_assert(opcodeCycles[0xC3].base == opcodeCycles[0xC2].base + opcodeCycles[0xC2].taken, "JP nn / JP cc,nn");
+static_assert(opcodeCycles[0xCD].base == opcodeCycles[0xC4].base + opcodeCycles[0xC4].taken, "CALL nn / CALL cc,nn");
+// RET cc spends an additional 4 cycles on checking the condition.
+static_assert(opcodeCycles[0xC9].base + 4 == opcodeCycles[0xC0].base + opcodeCycles[0xC0].taken, "RET / RET cc");
+
+// Conditions of the same instruction share timing.
+static_assert(opcodeCycles[0x20].taken == opcodeCycles[0x38].taken, "JR NZ,n / JR C,n");
+static_assert(opcodeCycles[0xC0].taken == opcodeCycles[0xD8].taken, "RET NZ / RET C");
+static_assert(opcodeCycles[0xC2].taken == opcodeCycles[0xDA].taken, "JP NZ,nn / JP C,nn");
+static_assert(opcodeCycles[0xC4].taken == opcodeCycles[0xDC].taken, "CALL NZ,nn / CALL C,nn");
+
+// Only conditional control flow has a taken penalty.
+static_assert(opcodeCycles[0x00].taken == 0 && opcodeCycles[0x18].taken == 0 && opcodeCycles[0xCD].taken == 0, "NOP / JR n / CALL nn");
+
+// (HL) operands cost an extra memory access.
+static_assert(opcodeCycles[0x7E].base == opcodeCycles[0x7F].base + 4, "LD A,(HL) / LD A,A");
+static_assert(opcodeCycles[0xBE].base == opcodeCycles[0xBF].base + 4, "CP (HL) / CP A");
+static_assert(extendedOpcodeCycles[0x06] == 16 && extendedOpcodeCycles[0xC6] == 16, "RLC (HL) / SET 0,(HL)");
+static_assert(extendedOpcodeCycles[0x46] == 12, "BIT 0,(HL)");
+static_assert(extendedOpcodeCycles[0x07] == 8 && extendedOpcodeCycles[0x7C] == 8 && extendedOpcodeCycles[0xFF] == 8, "RLC A / BIT 7,H / SET 7,A");
 
 #endif // CYCLES_H
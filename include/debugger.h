@@ -37,6 +37,9 @@ public slots:
     // Emulate one instruction.
     void on_buttonStepFrame_clicked();
 
+    // Go back one frame.
+    void on_buttonRewindFrame_clicked();
+
     // Set or unset breakpoint at PC.
     void on_textBreakpointPC_returnPressed();
 
@@ -55,6 +58,7 @@ signals:
     void playClicked();
     void stepClicked();
     void stepFrameClicked();
+    void rewindFrameClicked();
     void breakpointSet(uint16_t pc);
     void breakpointUnset();
 };
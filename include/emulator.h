@@ -1,12 +1,13 @@
 #ifndef EMULATOR_H
 #define EMULATOR_H
 
-#include "cpu.h"
-#include "gpu.h"
-#include "mmu.h"
-#include "timer.h"
+#include "machine.h"
+#include "movie.h"
+#include "rewind.h"
 
+#include <memory>
 #include <optional>
+#include <string>
 
 #include <QObject>
 #include <QTimer>
@@ -15,17 +16,18 @@ class Emulator : public QObject {
     Q_OBJECT
 
 public:
-    Emulator(const std::string& romFilename);
+    // Record joypad input of emulated frames into a movie saved to movieFilename on exit, unless it's empty.
+    Emulator(const std::string& romFilename, const std::string& movieFilename = {});
     virtual ~Emulator();
 
-    const Mmu& getMmu() const { return mmu; }
-    Mmu& getMmu() { return mmu; }
+    const Mmu& getMmu() const { return machine.getMmu(); }
+    Mmu& getMmu() { return machine.getMmu(); }
 
-    const Cpu& getCpu() const { return cpu; }
-    Cpu& getCpu() { return cpu; }
+    const Cpu& getCpu() const { return machine.getCpu(); }
+    Cpu& getCpu() { return machine.getCpu(); }
 
-    const Gpu& getGpu() const { return gpu; }
-    Gpu& getGpu() { return gpu; }
+    const Gpu& getGpu() const { return machine.getGpu(); }
+    Gpu& getGpu() { return machine.getGpu(); }
 
 public slots:
     // Emulate a single frame.
@@ -34,6 +36,12 @@ public slots:
     // Execute a single CPU instruction. Return true if frame finished.
     bool executeInstruction();
 
+    // Go back to the start of the last emulated frame.
+    void rewindFrame();
+
+    // Set joypad buttons (see Mmu::setJoypad) held down from the next frame on.
+    void setJoypad(uint8_t buttons);
+
     // Execute CPU instructions in a loop.
     void play();
 
@@ -52,13 +60,21 @@ signals:
     void frameFinished();
 
 private:
-    Mmu mmu;
-    Timer timer;
-    Cpu cpu;
-    Gpu gpu;
+    std::shared_ptr<const Rom> rom;
+    Machine machine;
+    Rewind rewind; // State at the start of each emulated frame
+    uint8_t joypad = 0;
+    std::optional<uint64_t> startedFrame; // Last frame handled by beginFrame
+
+    std::optional<MovieRecorder> recorder;
+    std::string movieFilename;
 
     QTimer* qtimer;
     std::optional<uint16_t> breakpoint;
+
+    // Call before executing instructions. When a new frame starts, push its state to the rewind
+    // history and apply and record the joypad buttons, which are held until the frame finishes.
+    void beginFrame();
 };
 
 #endif // EMULATOR_H
@@ -3,8 +3,10 @@
 
 #include "image.h"
 #include "mmu.h"
-#include "timer.h"
+#include "scheduler.h"
 
+#include <array>
+#include <gsl/span>
 #include <stdint.h>
 
 enum class Mode {
@@ -16,20 +18,56 @@ enum class Mode {
 
 class Gpu {
 public:
-    Gpu(Mmu& mmu, Timer& timer);
+    static constexpr unsigned int screenWidth = 160;
+    static constexpr unsigned int screenHeight = 144;
+
+    // Color index of pixels on lines not rendered since power on, which are left blank.
+    static constexpr uint8_t notRendered = 0xFF;
+
+    // Current mode and the color indices of the framebuffer rendered so far, which are a quarter
+    // of its size. The mode end event is part of Scheduler state.
+    struct State {
+        Mode mode;
+        uint64_t modeEnd;
+        std::array<uint8_t, screenWidth * screenHeight> colorIndices;
+    };
+
+    // Start in HBlank at cycle 0 and schedule its end.
+    Gpu(Mmu& mmu, Scheduler& scheduler);
 
     Image getTileData() const;
     Image getBgMap() const;
-    Image getScreenBuffer() const;
 
-    // Execute GPU step, return true if frame can be drawn.
-    bool step();
+    // Framebuffer with scanlines rendered so far, complete after VBlank starts.
+    const Image& getScreenBuffer() const { return framebuffer; }
+
+    // Color index (0-3) of each pixel of the framebuffer, row by row.
+    gsl::span<const uint8_t> getColorIndices() const { return colorIndices; }
+
+    // Handle Event::GpuModeEnd, enter the next mode and schedule its end. Return true if frame can be drawn.
+    bool endMode();
+
+    // Copy state into state. Without color indices, state.colorIndices is left unchanged.
+    void saveState(State& state, bool withColorIndices = true) const;
+
+    // Restore state and draw the framebuffer from its color indices.
+    void loadState(const State& state);
 
 private:
     Mode mode = Mode::HBlank;
 
     Mmu& mmu;
-    Timer& timer;
+    Scheduler& scheduler;
+    uint64_t modeEnd = 0; // Cycle at which the current mode ends
+
+    Image framebuffer;
+    std::array<uint8_t, screenWidth * screenHeight> colorIndices; // Drawn into framebuffer
+
+    // Switch to mode which lasts for cycles.
+    void enterMode(Mode newMode, uint64_t cycles);
+
+    // Render background of current line (LY) into framebuffer.
+    void renderScanline();
 
     /** Draw tile.
      * image - image to which tile data will be written
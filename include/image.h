@@ -1,6 +1,8 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <array>
+#include <cstddef>
 #include <stdint.h>
 #include <vector>
 
@@ -12,17 +14,32 @@ static const auto bytesPerPixel = 4;
 static const auto linesPerTile = 8;
 static const auto pixelsPerLine = 8;
 
+// Color indices (0-3) of a tile row, leftmost pixel first.
+using TileLine = std::array<uint8_t, pixelsPerLine>;
+
 class Image {
 public:
     Image(unsigned int width, unsigned int height);
 
     const uint8_t* getData() const;
+    uint8_t* getData() { return data.data(); }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+
+    // Size of data in bytes.
+    size_t getSize() const { return data.size(); }
 
     // Draw a pixel with color at (x, y).
     void drawPixel(unsigned int x, unsigned int y, Color color);
 
     // Draw a single line of a tile.
-    void drawLine(uint8_t byte0, uint8_t byte1, unsigned int tileX, unsigned int tileY, uint8_t scx, uint8_t scy, uint8_t line);
+    void drawLine(const TileLine& colors, unsigned int tileX, unsigned int tileY, uint8_t scx, uint8_t scy, uint8_t line);
+
+    // Draw a single line of a tile with its leftmost pixel at (x, y), pixels outside of image are skipped.
+    void drawTileLine(const TileLine& colors, int x, unsigned int y);
+
+    // Draw a whole row of the image from width color indices.
+    void drawScanline(const uint8_t* colors, unsigned int y);
 
 private:
     unsigned int width;
@@ -0,0 +1,75 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <gsl/span>
+#include <vector>
+
+// Compiled code needs an x86-64 host which can map executable memory.
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define GBEMU_HAS_JIT
+#endif
+
+class Cpu;
+
+// State shared between the CPU and compiled code, filled in before entering it.
+struct JitContext {
+    Cpu* cpu; // Passed to instruction handlers
+    uint16_t* pc;
+    const uint8_t** operand; // Next operand byte of the executing instruction
+    const uint32_t* codeEpoch;
+    const uint8_t* interruptFlag; // 0xFF0F
+    const uint8_t* interruptEnable; // 0xFFFF
+    uint32_t entryEpoch; // Code epoch the block was entered with
+    uint32_t limit; // Maximum number of instructions to execute
+    uint8_t interruptMask; // Interrupts which stop execution, 0 if ime is not set
+};
+
+// Instruction compiled into a call to its handler.
+struct JitInstruction {
+    void (*execute)(Cpu& cpu);
+    uint16_t address;
+    uint8_t opcodeLength;
+    const uint8_t* operands; // Must outlive the compiled code
+};
+
+// Compiled block. Executes up to context.limit instructions and returns how many it executed.
+// Execution stops early after an instruction which left PC elsewhere than the next instruction,
+// changed the code epoch or requested an interrupt enabled by context.interruptMask.
+using JitFunction = uint32_t (*)(JitContext* context);
+
+// Translates blocks of decoded instructions into x86-64 code calling their handlers directly,
+// which removes fetching and dispatch from the interpreter loop. Handlers still do all the work
+// and cycles are accounted by the caller, so compiled code behaves exactly like the interpreter.
+class JitCompiler {
+public:
+    JitCompiler() = default;
+    ~JitCompiler();
+
+    // Compiled code is owned by the compiler.
+    JitCompiler(const JitCompiler&) = delete;
+    JitCompiler& operator=(const JitCompiler&) = delete;
+
+    // Return true if the host can run compiled code.
+    static bool isSupported();
+
+    // Compile instructions, nullptr if code memory is used up or the host isn't supported.
+    JitFunction compile(gsl::span<const JitInstruction> instructions);
+
+    // Free all code memory. Functions compiled before must not be called anymore.
+    void clear();
+
+private:
+    // Executable memory is allocated in chunks, which are only writable while code is copied in.
+    static constexpr size_t chunkSize = 0x40000;
+    static constexpr size_t maxChunks = 64;
+
+    std::vector<uint8_t*> chunks;
+    size_t chunkUsed = chunkSize;
+
+    // Copy code into executable memory.
+    const uint8_t* install(const std::vector<uint8_t>& code);
+};
+
+#endif // JIT_H
@@ -0,0 +1,112 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "cartridge.h"
+#include "cpu.h"
+#include "gpu.h"
+#include "mmu.h"
+#include "scheduler.h"
+#include "timer.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <gsl/span>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+enum class StepResult {
+    Executed, // Instruction executed
+    FrameFinished, // Instruction executed and the GPU finished a frame
+    Breakpoint, // PC reached breakpoint
+    Stopped // Unimplemented opcode, nothing was executed
+};
+
+// Complete machine state in a single trivially copyable struct, so snapshots are taken and
+// restored with plain memory copies into preallocated storage. It's a few hundred KiB, so keep
+// it on the heap.
+struct MachineState {
+    Cpu::State cpu;
+    Mmu::State mmu;
+    Gpu::State gpu;
+    Scheduler::State scheduler;
+    uint64_t cycles;
+    uint64_t frameCount;
+    uint64_t instructionCount;
+};
+
+static_assert(std::is_trivially_copyable_v<MachineState>, "Snapshots are copied as raw memory");
+
+// Emulated hardware without a user interface or any timing, runs as fast as the host allows.
+class Machine {
+public:
+    Machine(const std::vector<uint8_t>& bootstrap, std::shared_ptr<const Rom> rom);
+
+    // Components hold references to each other.
+    Machine(const Machine&) = delete;
+    Machine& operator=(const Machine&) = delete;
+
+    const Mmu& getMmu() const { return mmu; }
+    Mmu& getMmu() { return mmu; }
+
+    const Cpu& getCpu() const { return cpu; }
+    Cpu& getCpu() { return cpu; }
+
+    const Gpu& getGpu() const { return gpu; }
+    Gpu& getGpu() { return gpu; }
+
+    // Execute a single CPU instruction and handle events which became due.
+    StepResult step();
+
+    // Execute instructions until the end of the current frame, or until PC reaches breakpoint
+    // or the CPU stops. Return FrameFinished, Breakpoint or Stopped.
+    StepResult runFrame(std::optional<uint16_t> breakpoint = {});
+
+    // Clock cycles since power on.
+    uint64_t getCycles() const { return timer.getCycles(); }
+
+    uint64_t getFrameCount() const { return frameCount; }
+    uint64_t getInstructionCount() const { return instructionCount; }
+
+    // Hash of CPU registers and the address space, for comparing runs.
+    uint64_t getStateHash() const;
+
+    // xxHash64 of the screen buffer.
+    uint64_t getFrameHash() const;
+
+    // Copy complete state into state, doesn't allocate. Without memory, the fields listed by
+    // getStateMemory are left unchanged.
+    void saveState(MachineState& state, bool withMemory = true) const;
+
+    // Memory which saveState copies into a field of MachineState.
+    struct StateMemory {
+        size_t offset; // Of the field in MachineState
+        size_t size; // Of the field
+        gsl::span<const uint8_t> data; // Copied to the start of the field, the rest is unused
+    };
+
+    // Large fields of MachineState in order of their offset, so states can be compared with
+    // snapshots without copying them first.
+    std::array<StateMemory, 3> getStateMemory() const;
+
+    // Restore state saved from a machine running the same cartridge, throws std::runtime_error
+    // if it was another one. Execution continues exactly as it did after the state was saved.
+    void loadState(const MachineState& state);
+
+private:
+    Mmu mmu;
+    Timer timer;
+    Scheduler scheduler;
+    Cpu cpu;
+    Gpu gpu;
+
+    uint64_t frameCount = 0;
+    uint64_t instructionCount = 0;
+
+    // Handle events due at current cycle. Return true if a frame finished.
+    bool handleEvents();
+};
+
+#endif // MACHINE_H
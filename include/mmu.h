@@ -1,37 +1,151 @@
 #ifndef MMU_H
 #define MMU_H
 
+#include "cartridge.h"
+#include "tilecache.h"
 #include "utils.h"
 
+#include <array>
 #include <cstdint>
 #include <gsl/span>
+#include <string>
 #include <vector>
 
-class Mmu {
+class Mmu : public MemoryReader {
 public:
+    // Memory contents and mapping. The bootstrap ROM and serial output captured so far aren't
+    // part of it.
+    struct State {
+        std::array<uint8_t, 0x8000> memory; // 0x8000-0xFFFF
+        bool isBootstrapMapped;
+        uint8_t joypad;
+        Cartridge::State cartridge;
+    };
+
     Mmu();
 
+    // Page table holds pointers into memory, copying would leave them dangling.
+    Mmu(const Mmu&) = delete;
+    Mmu& operator=(const Mmu&) = delete;
+
     // Set memory value at address.
     void set(uint16_t address, uint8_t value);
 
     // Get memory value at address.
     uint8_t get(uint16_t address) const;
 
-    // Load bootstrap ROM into memory.
+    // Get memory value at address, for readers which don't depend on Mmu such as the disassembler.
+    uint8_t read(uint16_t address) const override;
+
+    // Load bootstrap ROM and map it over the first page of cartridge ROM.
     void loadBootstrap(const std::vector<uint8_t>& rom);
 
-    // Load cartridge ROM into memory.
-    void loadCartridge(const std::vector<uint8_t>& cartridgeStart);
+    // Insert cartridge with given ROM, its banks are mapped at 0x0000-0x7FFF and 0xA000-0xBFFF.
+    void loadCartridge(std::shared_ptr<const Rom> rom);
+
+    // Take ownership of cartridge ROM data and insert it.
+    void loadCartridge(std::vector<uint8_t> rom);
 
     // Return a view of VRAM data.
     const gsl::span<const uint8_t> getVram() const;
 
-    // Return contents of memory.
-    std::vector<uint8_t> getMemory() const;
+    // Get tile from tile data at 0x8000-0x97FF decoded to color indices.
+    const Tile& getTile(unsigned int index) const;
+
+    // Joypad buttons, combined into the mask given to setJoypad.
+    static const uint8_t buttonRight = 1 << 0;
+    static const uint8_t buttonLeft = 1 << 1;
+    static const uint8_t buttonUp = 1 << 2;
+    static const uint8_t buttonDown = 1 << 3;
+    static const uint8_t buttonA = 1 << 4;
+    static const uint8_t buttonB = 1 << 5;
+    static const uint8_t buttonSelect = 1 << 6;
+    static const uint8_t buttonStart = 1 << 7;
+
+    // Set buttons held down. The joypad register (0xFF00) shows the ones on lines the program
+    // selected, pressing one of those requests the joypad interrupt. Only call this between CPU runs.
+    void setJoypad(uint8_t buttons);
+
+    uint8_t getJoypad() const { return joypad; }
+
+    // Bytes sent over the serial link so far.
+    const std::string& getSerialOutput() const { return serialOutput; }
+
+    // Memory backing the page containing address. Changes when another bank is mapped there.
+    const uint8_t* getPage(uint16_t address) const { return readPages[address >> 8]; }
+
+    // Number of the cartridge ROM bank mapped at address, which must be below 0x8000.
+    size_t getRomBankNumber(uint16_t address) const { return address < 0x4000 ? cartridge.getRomBank0Number() : cartridge.getRomBankNumber(); }
+
+    // Report writes to the work RAM (0xC000-0xDFFF) page containing address, which holds code decoded
+    // by the CPU. The first write increments the code version of the page and stops watching it.
+    void watchCode(uint16_t address);
+
+    // Version of code in the page containing address, changes when watched work RAM is written.
+    uint32_t getCodeVersion(uint16_t address) const { return codeVersions[address >> 8]; }
+
+    // Incremented whenever a watched page is written or banks are switched, so code decoded ahead
+    // of execution may have changed.
+    const uint32_t& getCodeEpoch() const { return codeEpoch; }
+
+    // Memory at 0x8000-0xFFFF, external RAM is provided by getCartridgeRam.
+    gsl::span<const uint8_t> getMemory() const { return memory; }
+
+    gsl::span<const uint8_t> getCartridgeRam() const { return cartridge.getRam(); }
+
+    // Copy state into state. Without memory, state.memory and the cartridge RAM are left unchanged.
+    void saveState(State& state, bool withMemory = true) const;
+
+    // Restore state, all code in work RAM is treated as changed.
+    void loadState(const State& state);
 
 private:
-    std::vector<uint8_t> memory;
-    std::vector<uint8_t> cartridgeStart;
+    static constexpr auto pageSize = 0x100;
+    static constexpr auto pageCount = 0x100;
+    static constexpr auto romSize = 0x8000;
+
+    std::vector<uint8_t> bootstrap;
+    bool isBootstrapMapped = false;
+    Cartridge cartridge;
+    std::vector<uint8_t> memory; // 0x8000-0xFFFF, external RAM is provided by cartridge
+    std::string serialOutput;
+    uint8_t joypad = 0; // Buttons held down
+    mutable TileCache tiles; // Invalidated by writes to tile data
+    std::array<uint32_t, 0x100> codeVersions{};
+    uint32_t codeEpoch = 0;
+
+    // Page table with one entry per 256 byte page of the address space.
+    // Reads always go through readPages. Pages without a write pointer have side effects on write
+    // and are handled by setIo.
+    std::array<const uint8_t*, pageCount> readPages;
+    std::array<uint8_t*, pageCount> writePages;
+
+    // Update joypad register from buttons and lines selected by bits 4 and 5 of select.
+    void updateJoypad(uint8_t select);
+
+    // Point page table entries at cartridge and memory.
+    void mapPages();
+
+    // Point page table entries at currently selected cartridge banks.
+    void mapCartridge();
+
+    // Write to memory bank controller, tile data, disabled external RAM, watched code or a page with
+    // I/O registers.
+    void setIo(uint16_t address, uint8_t value);
 };
 
+inline void Mmu::set(uint16_t address, uint8_t value)
+{
+    if (auto page = writePages[address >> 8]) {
+        page[address & 0xFF] = value;
+    } else {
+        setIo(address, value);
+    }
+}
+
+inline uint8_t Mmu::get(uint16_t address) const
+{
+    return readPages[address >> 8][address & 0xFF];
+}
+
 #endif // MMU_H
@@ -0,0 +1,51 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "cartridge.h"
+#include "machine.h"
+
+#include <cstdint>
+#include <gsl/span>
+#include <vector>
+
+// Version of the movie format, incremented whenever its layout changes.
+constexpr uint32_t movieVersion = 1;
+
+// Joypad input recorded one frame at a time. Replaying it from its start state on the same ROM
+// reproduces the recorded run exactly.
+struct Movie {
+    uint64_t romHash = 0; // hashRom of the ROM it was recorded with
+    std::vector<uint8_t> startState; // Binary save state the recording started from
+    std::vector<uint8_t> frames; // Joypad buttons (see Mmu::setJoypad) held during each frame
+};
+
+// Hash of whole ROM contents.
+uint64_t hashRom(const Rom& rom);
+
+// Encode movie: "GBMV", the format version, ROM hash, start state size, frame count, start
+// state and frames, little endian.
+std::vector<uint8_t> serializeMovie(const Movie& movie);
+
+// Decode movie. Throws std::runtime_error if data isn't a movie of the current version or is truncated.
+Movie deserializeMovie(gsl::span<const uint8_t> data);
+
+// Records a movie of a machine run by whole frames, frames interrupted by breakpoints or single
+// instructions. Input is keyed by frame number, so it replays in sync however the frames were run.
+class MovieRecorder {
+public:
+    // Start recording from the current state of machine.
+    MovieRecorder(const Machine& machine, const Rom& rom);
+
+    // Record the joypad buttons of machine for its current frame. Call when a frame starts, buttons
+    // must not change until it finishes. Input recorded for later frames, e.g. before rewinding, is dropped.
+    void record(const Machine& machine);
+
+    // Movie of the frames machine finished since recording started.
+    Movie getMovie(const Machine& machine) const;
+
+private:
+    Movie movie;
+    uint64_t startFrame;
+};
+
+#endif // MOVIE_H
@@ -0,0 +1,57 @@
+#ifndef PIXELDECODER_H
+#define PIXELDECODER_H
+
+#include "image.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Pixel in Image data byte order (r, g, b, unused).
+using Pixel = uint32_t;
+
+// Pixels for color indices 0-3.
+using PixelPalette = std::array<Pixel, 4>;
+
+// Convert color to pixel.
+Pixel toPixel(Color color);
+
+// Decode 8 pixel wide tile rows into color indices. data holds (low, high) bit plane byte pairs,
+// one pair per row, 8 indices per row are written to colorIndices.
+using DecodeRowsKernel = void (*)(const uint8_t* data, size_t rows, uint8_t* colorIndices);
+
+// Convert color indices into pixels, 4 bytes per pixel are written to pixels.
+using ResolveColorsKernel = void (*)(const uint8_t* colorIndices, size_t count, const PixelPalette& palette, uint8_t* pixels);
+
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+struct PixelKernels {
+    SimdLevel level;
+    const char* name;
+    DecodeRowsKernel decodeRows;
+    ResolveColorsKernel resolveColors;
+};
+
+// Get kernels for instruction set, nullptr if the host CPU or compiler doesn't support it.
+const PixelKernels* getPixelKernels(SimdLevel level);
+
+// Get kernels for the best instruction set supported by the host CPU, selected once at startup.
+const PixelKernels& getPixelKernels();
+
+// Decode tile rows with the best supported kernel.
+inline void decodeTileRows(const uint8_t* data, size_t rows, uint8_t* colorIndices)
+{
+    getPixelKernels().decodeRows(data, rows, colorIndices);
+}
+
+// Resolve color indices with the best supported kernel.
+inline void resolveColors(const uint8_t* colorIndices, size_t count, const PixelPalette& palette, uint8_t* pixels)
+{
+    getPixelKernels().resolveColors(colorIndices, count, palette, pixels);
+}
+
+#endif // PIXELDECODER_H
@@ -0,0 +1,77 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "machine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <gsl/span>
+#include <memory>
+#include <vector>
+
+// History of machine states, one per recorded frame, for stepping back in time.
+//
+// A state is recorded as a snapshot of the registers saved without memory, and of the memory listed
+// by Machine::getStateMemory read in place, so recording doesn't copy the whole state. Snapshots are
+// grouped after keyframes. Each one is stored as its XOR with the group's keyframe (a keyframe with
+// zeros), with runs of unchanged 8 byte words collapsed, so a frame costs about as much as the
+// memory it changed since the keyframe. When the history grows over the memory budget, the oldest
+// group is dropped.
+class Rewind {
+public:
+    static constexpr size_t defaultMemoryBudget = 8 << 20;
+    static constexpr unsigned defaultKeyframeInterval = 60;
+
+    explicit Rewind(size_t memoryBudget = defaultMemoryBudget, unsigned keyframeInterval = defaultKeyframeInterval);
+
+    // Record current state of machine. All states must be recorded from machines running the
+    // same cartridge.
+    void push(const Machine& machine);
+
+    // Restore the most recently recorded state into machine and remove it from the history.
+    // Returns false if the history is empty.
+    bool rewind(Machine& machine);
+
+    // Remove all recorded states.
+    void clear();
+
+    // Number of recorded states.
+    size_t size() const { return frames.size(); }
+
+    // Bytes used by recorded states, excluding the fixed size buffers used to encode them.
+    size_t getMemoryUsage() const { return memoryUsage; }
+
+private:
+    struct Frame {
+        std::vector<uint8_t> delta;
+        unsigned groupPosition; // 0 for keyframes
+    };
+
+    // Part of a snapshot, read from data and restored at offset in MachineState. Each one starts at
+    // a whole word in the snapshot.
+    struct Part {
+        size_t offset;
+        gsl::span<const uint8_t> data;
+    };
+
+    size_t memoryBudget;
+    unsigned keyframeInterval;
+    std::deque<Frame> frames;
+    size_t memoryUsage = 0;
+
+    std::unique_ptr<MachineState> state; // Scratch state, only its registers are recorded
+    std::vector<Part> parts; // Parts of the snapshot of state
+    std::vector<uint8_t> keyframe; // Snapshot of the newest group's keyframe
+    std::vector<uint8_t> snapshot; // Scratch snapshot for restoring
+    std::vector<uint8_t> encoded; // Scratch encoding buffer
+
+    // Split state of machine saved in state into parts: the fields of state between the ones
+    // listed by Machine::getStateMemory, and the memory of those. Returns snapshot size.
+    size_t splitState(const Machine& machine);
+
+    // Decode keyframe of the newest group into keyframe.
+    void decodeKeyframe();
+};
+
+#endif // REWIND_H
@@ -0,0 +1,21 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include "machine.h"
+
+#include <cstdint>
+#include <gsl/span>
+#include <vector>
+
+// Version of the binary save state format, incremented whenever its layout changes.
+constexpr uint32_t saveStateVersion = 1;
+
+// Encode state in the binary save state format: "GBSS", the format version, then every field in
+// little endian byte order without padding. Only the cartridge RAM present is stored.
+std::vector<uint8_t> serializeState(const MachineState& state);
+
+// Decode binary save state into state. Throws std::runtime_error if data isn't a save state of the
+// current version or is truncated.
+void deserializeState(gsl::span<const uint8_t> data, MachineState& state);
+
+#endif // SAVESTATE_H
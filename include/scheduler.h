@@ -0,0 +1,58 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Events components schedule for themselves, handled by Machine when their cycle is reached.
+enum class Event {
+    GpuModeEnd
+};
+
+// Min-heap of events keyed on absolute cycle count. The CPU runs freely until the earliest deadline.
+class Scheduler {
+public:
+    static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t maxStateEntries = 8;
+
+    struct Entry {
+        uint64_t cycle;
+        uint64_t order; // Events at the same cycle are handled in the order they were scheduled
+        Event event;
+    };
+
+    // Pending events in heap order.
+    struct State {
+        std::array<Entry, maxStateEntries> entries;
+        uint32_t entryCount;
+        uint64_t scheduled;
+    };
+
+    // Schedule event at cycle.
+    void schedule(Event event, uint64_t cycle);
+
+    // Cycle of the earliest event, never if nothing is scheduled.
+    uint64_t getNextDeadline() const { return entries.empty() ? never : entries.front().cycle; }
+
+    // Remove and return the earliest event if it is due at cycle.
+    std::optional<Event> popDue(uint64_t cycle);
+
+    // Copy state into state, throws std::runtime_error if more than maxStateEntries events are pending.
+    void saveState(State& state) const;
+
+    // Restore state.
+    void loadState(const State& state);
+
+private:
+    std::vector<Entry> entries; // Heap with the earliest entry at the front
+    uint64_t scheduled = 0;
+
+    // Heap order, true if a is handled after b.
+    static bool isLater(const Entry& a, const Entry& b);
+};
+
+#endif // SCHEDULER_H
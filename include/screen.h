@@ -21,10 +21,18 @@ public slots:
     // Draw contents of LCD screen.
     void redraw();
 
+signals:
+    // Buttons held down changed, arrow keys are the directions, X is A, Z is B, Enter is Start
+    // and Backspace is Select.
+    void joypadChanged(uint8_t buttons);
+
 private:
     const Emulator& emulator;
     Ui::Screen* ui;
+    uint8_t joypad = 0;
 
+    void keyPressEvent(QKeyEvent* event) override;
+    void keyReleaseEvent(QKeyEvent* event) override;
     void resizeEvent(QResizeEvent* event) override;
     void closeEvent(QCloseEvent* event) override;
 };
@@ -0,0 +1,39 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "image.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <gsl/span>
+
+using Tile = std::array<TileLine, linesPerTile>;
+
+// Decode a tile row from its two bit planes, low bits come first in VRAM.
+TileLine decodeTileLine(uint8_t low, uint8_t high);
+
+// Tiles from VRAM tile data (0x8000-0x97FF) decoded to color indices. Tiles are decoded again
+// only after they are invalidated, tile data rarely changes between frames.
+class TileCache {
+public:
+    static constexpr auto tileCount = 384;
+    static constexpr auto bytesPerTile = 16;
+
+    TileCache();
+
+    // Mark tile as changed, it will be decoded again when it's needed.
+    void invalidate(unsigned int tile) { dirty.set(tile); }
+
+    // Mark all tiles as changed.
+    void invalidateAll() { dirty.set(); }
+
+    // Get decoded tile, tileData starts at 0x8000.
+    const Tile& get(gsl::span<const uint8_t> tileData, unsigned int tile);
+
+private:
+    std::array<Tile, tileCount> tiles;
+    std::bitset<tileCount> dirty;
+};
+
+#endif // TILECACHE_H
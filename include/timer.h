@@ -1,17 +1,22 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <cstdint>
+
+// Clock cycles elapsed since power on. Only the CPU advances it, other components schedule
+// events at absolute cycle counts instead of resetting it.
 class Timer {
 public:
     Timer();
 
-    int getCycles() const;
-    void setCycles(int n);
-    void increment(int n);
-    void reset();
+    uint64_t getCycles() const;
+    void increment(uint64_t n);
+
+    // Set cycle count when restoring state.
+    void setCycles(uint64_t n);
 
 private:
-    int cycles = 0;
+    uint64_t cycles = 0;
 };
 
 #endif // TIMER_H
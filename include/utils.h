@@ -1,48 +1,99 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <array>
+#include <cstdint>
+#include <gsl/span>
 #include <memory>
-#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include <json.hpp>
-
 // Read whole file into a buffer and return it.
 std::vector<uint8_t> readFile(const std::string& path);
 
+// Replace contents of file with data.
+void writeFile(const std::string& path, gsl::span<const uint8_t> data);
+
 // Return true if adding n + m results in carry from low nibble to high (bit 3 to 4).
-bool isHalfCarryAddition(uint8_t n, uint8_t m);
+inline bool isHalfCarryAddition(uint8_t n, uint8_t m) { return ((n & 0xf) + (m & 0xf)) > 0xf; }
 
 // Return true if subtracting n - m does not result in borrowing from high nibble to low (bit 4 to 3).
-bool isHalfCarrySubtraction(int8_t n, int8_t m);
+inline bool isHalfCarrySubtraction(int8_t n, int8_t m) { return (n & 0xf) - (m & 0xf) < 0; }
 
 // Return true if adding n + m results in carry from low nibble to high in high byte (bit 11 to 12).
-bool isHalfCarryAddition16(uint16_t n, uint16_t m);
+inline bool isHalfCarryAddition16(uint16_t n, uint16_t m) { return ((n & 0xfff) + (m & 0xfff)) > 0xfff; }
 
-// Test if bit n of byte is set.
-bool isBitSet(uint8_t n, uint8_t byte);
+// Test if bit n of byte is set. Only the low 3 bits of n are used.
+inline bool isBitSet(uint8_t n, uint8_t byte) { return (byte >> (n & 7)) & 1; }
 
 // Concatenate 2 bytes into 16 bit int.
-uint16_t concatBytes(uint8_t lo, uint8_t hi);
+inline uint16_t concatBytes(uint8_t lo, uint8_t hi) { return static_cast<uint16_t>((hi << 8) | lo); }
+
+// FNV-1a offset basis, the hash of no data.
+constexpr uint64_t initialHash = 0xcbf29ce484222325;
+
+// 64 bit FNV-1a hash of data, continuing from hash so that data can be hashed in parts.
+uint64_t hashBytes(gsl::span<const uint8_t> data, uint64_t hash = initialHash);
+
+// 64 bit xxHash (XXH64) of data. Hashes 32 bytes per round, much faster than hashBytes on large buffers
+// like frames.
+uint64_t xxHash64(gsl::span<const uint8_t> data, uint64_t seed = 0);
+
+// Encode pixels, 4 bytes per pixel (red, green, blue, unused), as an uncompressed 24 bit PNG file.
+std::vector<uint8_t> encodePng(gsl::span<const uint8_t> pixels, unsigned int width, unsigned int height);
+
+// Source of bytes to disassemble.
+class MemoryReader {
+public:
+    virtual ~MemoryReader() = default;
+
+    // Get byte at address.
+    virtual uint8_t read(uint16_t address) const = 0;
+};
 
+// Reads bytes from a buffer, bytes past its end read as 0.
+class BufferReader : public MemoryReader {
+public:
+    explicit BufferReader(gsl::span<const uint8_t> buffer);
+
+    uint8_t read(uint16_t address) const override;
+
+private:
+    gsl::span<const uint8_t> buffer;
+};
+
+// Opcode metadata, generated at build time from lib/opcodes/opcodes.json.
+struct OpcodeData {
+    const char* mnemonic = nullptr; // nullptr for unused opcodes
+    uint8_t length = 0;
+    const char* operand1 = nullptr;
+    const char* operand2 = nullptr;
+};
+
+// Get opcode data, prefixedOpcode is used only if unprefixedOpcode is 0xCB. Return nullptr for unused opcodes.
+const OpcodeData* getOpcodeData(uint8_t unprefixedOpcode, uint8_t prefixedOpcode);
+
+// Decoded instruction. Plain data, so disassembling doesn't allocate, text is formatted on demand.
 struct Instruction {
-    uint16_t pc;
-    std::string mnemonic;
-    std::optional<std::string> operand1;
-    std::optional<std::string> operand2;
-    std::vector<uint8_t> bytes;
-
-    std::string bytesToString();
-    std::string operandsToString();
+    uint16_t pc = 0;
+    const OpcodeData* opcode = nullptr; // nullptr for unused opcodes
+    uint8_t length = 1;
+    std::array<uint8_t, 3> bytes{}; // Only the first length bytes are valid
+    uint16_t value = 0; // Immediate operand, or target address of relative jumps
+
+    // Mnemonic, empty for unused opcodes.
+    const char* mnemonic() const { return opcode ? opcode->mnemonic : ""; }
 };
 
-nlohmann::json readOpcodes();
+// Format instruction bytes as hex ("31 FE FF ") into buffer. Text which doesn't fit is truncated.
+std::string_view formatBytes(const Instruction& instr, gsl::span<char> buffer);
 
-// Get opcode data from json.
-std::optional<nlohmann::json> getOpcodeData(uint8_t unprefixedOpcode, uint8_t prefixedOpcode);
+// Format comma separated operands with immediate values filled in ("SP,$fffe") into buffer.
+// Text which doesn't fit is truncated.
+std::string_view formatOperands(const Instruction& instr, gsl::span<char> buffer);
 
-// Disassemble LR35902 opcodes into assembly language.
-Instruction disassemble(const std::vector<uint8_t>& code, uint16_t pc);
+// Disassemble LR35902 opcode at pc into assembly language.
+Instruction disassemble(const MemoryReader& memory, uint16_t pc);
 
 #endif // UTILS_H
@@ -0,0 +1,379 @@
+#include "gpu.h"
+#include "image.h"
+#include "jit.h"
+#include "machine.h"
+#include "mmu.h"
+#include "rewind.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+static const char* usage = "Usage: gbemu-bench [--samples n] [--filter text] [--bootstrap path] [--rom path]";
+
+struct Options {
+    unsigned int samples = 15;
+    std::string filter; // Run only benchmarks with names containing it
+    std::string bootstrapFilename = "../gbemu/res/bootstrap.bin"; // Same as emulator
+    std::string romFilename = "../gbemu/res/cpu_instrs/cpu_instrs.gb";
+};
+
+// Work done by one call of a benchmark body. Cycles are emulated clock cycles, 0 if the body
+// doesn't emulate time.
+struct Work {
+    uint64_t ops = 0;
+    uint64_t cycles = 0;
+};
+
+using Body = std::function<Work()>;
+
+// Setup runs once, untimed, and returns the body which is timed. Bodies keep their state between
+// calls, so they must leave it ready for the next call.
+struct Benchmark {
+    std::string name;
+    std::function<Body()> setup;
+};
+
+// Keeps results of benchmarked reads alive, so the compiler can't remove them.
+static volatile uint64_t sink;
+
+static const auto minSampleTime = std::chrono::milliseconds(20);
+
+static Options parseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(fmt::format("Missing value for {}.\n{}", arg, usage));
+            }
+            return argv[++i];
+        };
+        if (arg == "--samples") {
+            options.samples = std::max(1u, static_cast<unsigned int>(std::stoul(value())));
+        } else if (arg == "--filter") {
+            options.filter = value();
+        } else if (arg == "--bootstrap") {
+            options.bootstrapFilename = value();
+        } else if (arg == "--rom") {
+            options.romFilename = value();
+        } else {
+            throw std::runtime_error(fmt::format("Unknown argument {}.\n{}", arg, usage));
+        }
+    }
+    return options;
+}
+
+// CPU with memory running a looping program from address 0, without boot ROM or GPU.
+struct CpuFixture {
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+
+    explicit CpuFixture(std::vector<uint8_t> program) { mmu.loadCartridge(std::move(program)); }
+};
+
+// Execute instructions one at a time through Cpu::execute.
+static Benchmark executeBenchmark(std::string name, std::vector<uint8_t> program)
+{
+    return { std::move(name), [program] {
+                auto fixture = std::make_shared<CpuFixture>(program);
+                return [fixture] {
+                    static const uint64_t instructions = 10000;
+                    auto start = fixture->timer.getCycles();
+                    for (uint64_t i = 0; i < instructions; ++i) {
+                        if (!fixture->cpu.execute()) {
+                            throw std::runtime_error("Benchmark program has an unimplemented opcode");
+                        }
+                    }
+                    return Work{ instructions, fixture->timer.getCycles() - start };
+                };
+            } };
+}
+
+// Execute instructions in batches through Cpu::run, which uses decoded blocks and the JIT if enabled.
+static Benchmark runBenchmark(std::string name, std::vector<uint8_t> program, bool jit)
+{
+    return { std::move(name), [program, jit] {
+                auto fixture = std::make_shared<CpuFixture>(program);
+                if (jit && !fixture->cpu.setJitEnabled(true)) {
+                    throw std::runtime_error("JIT is not supported on this host");
+                }
+                return [fixture] {
+                    auto result = fixture->cpu.run(40000);
+                    if (result.reason == StopReason::UnimplementedOpcode) {
+                        throw std::runtime_error("Benchmark program has an unimplemented opcode");
+                    }
+                    return Work{ result.instructions, result.cycles };
+                };
+            } };
+}
+
+// Read every address of a region.
+static Benchmark getBenchmark(std::string name, uint16_t first, uint16_t last)
+{
+    return { std::move(name), [first, last] {
+                auto mmu = std::make_shared<Mmu>();
+                return [mmu, first, last] {
+                    uint64_t sum = 0;
+                    for (auto address = 0u + first; address <= last; ++address) {
+                        sum += mmu->get(static_cast<uint16_t>(address));
+                    }
+                    sink = sum;
+                    return Work{ static_cast<uint64_t>(last - first + 1), 0 };
+                };
+            } };
+}
+
+// Write every address of a list, short lists repeatedly so calling the body doesn't dominate.
+static Benchmark setBenchmark(std::string name, std::vector<uint16_t> addresses)
+{
+    return { std::move(name), [addresses] {
+                auto mmu = std::make_shared<Mmu>();
+                return [mmu, addresses] {
+                    auto repeats = std::max<size_t>(1, 0x1000 / addresses.size());
+                    uint8_t value = 0;
+                    for (size_t i = 0; i < repeats; ++i) {
+                        for (auto address : addresses) {
+                            mmu->set(address, value++);
+                        }
+                    }
+                    return Work{ repeats * addresses.size(), 0 };
+                };
+            } };
+}
+
+static std::vector<uint16_t> addressRange(uint16_t first, uint16_t last)
+{
+    std::vector<uint16_t> addresses;
+    for (auto address = 0u + first; address <= last; ++address) {
+        addresses.push_back(static_cast<uint16_t>(address));
+    }
+    return addresses;
+}
+
+// GPU with every tile and background map entry filled, so each scanline draws distinct tiles.
+struct GpuFixture {
+    Mmu mmu;
+    Scheduler scheduler;
+    Gpu gpu{ mmu, scheduler };
+
+    GpuFixture()
+    {
+        for (auto address = 0x8000u; address < 0x9800; ++address) {
+            mmu.set(static_cast<uint16_t>(address), static_cast<uint8_t>(address * 37 >> 3));
+        }
+        for (auto address = 0x9800u; address < 0xA000; ++address) {
+            mmu.set(static_cast<uint16_t>(address), static_cast<uint8_t>(address));
+        }
+        mmu.set(0xFF42, 3); // SCY and SCX not on tile boundaries
+        mmu.set(0xFF43, 5);
+    }
+
+    // Handle GPU mode ends until a frame is finished.
+    void runFrame()
+    {
+        while (true) {
+            scheduler.popDue(scheduler.getNextDeadline());
+            if (gpu.endMode()) {
+                return;
+            }
+        }
+    }
+};
+
+// Emulate whole frames of a ROM, each call restarting from the same state after the boot ROM.
+// With rewind, the state at the start of each frame is recorded as the emulator does.
+static Benchmark frameBenchmark(std::string name, const Options& options, bool jit, bool rewind = false)
+{
+    return { std::move(name), [options, jit, rewind] {
+                auto machine = std::make_shared<Machine>(readFile(options.bootstrapFilename), Rom::open(options.romFilename));
+                if (jit && !machine->getCpu().setJitEnabled(true)) {
+                    throw std::runtime_error("JIT is not supported on this host");
+                }
+                while (machine->getFrameCount() < 300) {
+                    machine->runFrame();
+                }
+                auto state = std::make_shared<MachineState>();
+                machine->saveState(*state);
+                auto history = rewind ? std::make_shared<Rewind>() : nullptr;
+                return [machine, state, history] {
+                    static const uint64_t frames = 30;
+                    machine->loadState(*state);
+                    auto start = machine->getCycles();
+                    for (uint64_t i = 0; i < frames; ++i) {
+                        if (history) {
+                            history->push(*machine);
+                        }
+                        if (machine->runFrame() == StepResult::Stopped) {
+                            throw std::runtime_error("ROM stopped on an unimplemented opcode");
+                        }
+                    }
+                    return Work{ frames, machine->getCycles() - start };
+                };
+            } };
+}
+
+static std::vector<Benchmark> makeBenchmarks(const Options& options)
+{
+    // ADD A,A; XOR B; INC D; DEC E; OR D; AND C; SUB B; RLA; ADD HL,DE; CP 5; ADC A,1; DEC C; JR NZ,0; JR 0
+    std::vector<uint8_t> alu{ 0x87, 0xA8, 0x14, 0x1D, 0xB2, 0xA1, 0x90, 0x17, 0x19, 0xFE, 0x05, 0xCE, 0x01, 0x0D, 0x20, 0xF0, 0x18, 0xEE };
+    // LD HL,$C000; loop: LD (HL),A; LD A,(HL); INC L; LD B,A; LD C,A; LD (HL+),A; LD A,(HL+); LD ($C180),A;
+    // LD A,($C180); LDH ($80),A; LDH A,($80); LD A,L; AND $7F; LD L,A; JR loop
+    std::vector<uint8_t> loads{ 0x21, 0x00, 0xC0, 0x77, 0x7E, 0x2C, 0x47, 0x4F, 0x22, 0x2A, 0xEA, 0x80, 0xC1, 0xFA, 0x80, 0xC1,
+        0xE0, 0x80, 0xF0, 0x80, 0x7D, 0xE6, 0x7F, 0x6F, 0x18, 0xE9 };
+    // LD SP,$DFFE; loop: PUSH BC; PUSH DE; CALL sub; POP DE; POP BC; JP loop; sub: INC BC; INC DE; RET
+    std::vector<uint8_t> calls{ 0x31, 0xFE, 0xDF, 0xC5, 0xD5, 0xCD, 0x0D, 0x00, 0xD1, 0xC1, 0xC3, 0x03, 0x00, 0x03, 0x13, 0xC9 };
+    // SWAP A; BIT 7,H; RL C; SRL A; RR D; RR C; SRL B; JR 0
+    std::vector<uint8_t> prefixed{ 0xCB, 0x37, 0xCB, 0x7C, 0xCB, 0x11, 0xCB, 0x3F, 0xCB, 0x1A, 0xCB, 0x19, 0xCB, 0x38, 0x18, 0xF0 };
+
+    std::vector<Benchmark> benchmarks{
+        executeBenchmark("cpu/execute alu", alu),
+        executeBenchmark("cpu/execute loads", loads),
+        executeBenchmark("cpu/execute calls", calls),
+        executeBenchmark("cpu/execute prefixed", prefixed),
+        runBenchmark("cpu/run alu", alu, false),
+        runBenchmark("cpu/run loads", loads, false),
+        getBenchmark("mmu/get rom", 0x0000, 0x7FFF),
+        getBenchmark("mmu/get vram", 0x8000, 0x9FFF),
+        getBenchmark("mmu/get wram", 0xC000, 0xDFFF),
+        getBenchmark("mmu/get io and hram", 0xFF00, 0xFFFF),
+        setBenchmark("mmu/set wram", addressRange(0xC000, 0xDFFF)),
+        setBenchmark("mmu/set hram", addressRange(0xFF80, 0xFFFE)),
+        setBenchmark("mmu/set tile data", addressRange(0x8000, 0x97FF)),
+        setBenchmark("mmu/set scroll and palette", { 0xFF42, 0xFF43, 0xFF47, 0xFF48, 0xFF49, 0xFF4A, 0xFF4B }),
+        // Mode changes of a whole frame, per visible scanline.
+        { "gpu/scanline", [] {
+             auto fixture = std::make_shared<GpuFixture>();
+             return [fixture] {
+                 fixture->runFrame();
+                 return Work{ Gpu::screenHeight, 0 };
+             };
+         } },
+        { "gpu/getScreenBuffer hash", [] {
+             auto fixture = std::make_shared<GpuFixture>();
+             fixture->runFrame();
+             return [fixture] {
+                 const Image& screen = fixture->gpu.getScreenBuffer();
+                 sink = xxHash64(gsl::make_span(screen.getData(), screen.getSize()));
+                 return Work{ 1, 0 };
+             };
+         } },
+        { "image/drawLine", [] {
+             auto image = std::make_shared<Image>(256, 256);
+             return [image] {
+                 TileLine colors{ 0, 1, 2, 3, 3, 2, 1, 0 };
+                 for (auto tileY = 0u; tileY < 32; ++tileY) {
+                     for (auto tileX = 0u; tileX < 32; ++tileX) {
+                         for (uint8_t line = 0; line < linesPerTile; ++line) {
+                             image->drawLine(colors, tileX, tileY, 5, 3, line);
+                         }
+                     }
+                 }
+                 return Work{ 32 * 32 * linesPerTile, 0 };
+             };
+         } },
+        frameBenchmark("frame/cpu_instrs", options, false),
+        frameBenchmark("frame/cpu_instrs rewind", options, false, true),
+    };
+    if (JitCompiler::isSupported()) {
+        benchmarks.push_back(runBenchmark("cpu/run alu jit", alu, true));
+        benchmarks.push_back(runBenchmark("cpu/run loads jit", loads, true));
+        benchmarks.push_back(frameBenchmark("frame/cpu_instrs jit", options, true));
+    }
+    return benchmarks;
+}
+
+struct Statistics {
+    double median; // ns/op
+    double min; // ns/op
+    double spread; // Median absolute deviation relative to the median
+    double megahertz; // Emulated clock speed at the median, 0 if not emulating time
+};
+
+// Time samples of at least minSampleTime each, after calibrating how many body calls that takes.
+// The median and its deviation ignore outliers caused by other processes, unlike mean and variance.
+static Statistics measure(const Body& body, unsigned int samples)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    body(); // Warms up caches, decoded blocks and compiled code
+    auto once = Clock::now() - start;
+    auto calls = std::max<uint64_t>(1, static_cast<uint64_t>(minSampleTime / std::max(once, Clock::duration{ 1 })));
+
+    std::vector<double> nsPerOp;
+    std::vector<double> megahertz;
+    for (auto sample = 0u; sample < samples; ++sample) {
+        Work work;
+        start = Clock::now();
+        for (uint64_t call = 0; call < calls; ++call) {
+            auto done = body();
+            work.ops += done.ops;
+            work.cycles += done.cycles;
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        nsPerOp.push_back(ns / work.ops);
+        megahertz.push_back(work.cycles / ns * 1000);
+    }
+
+    auto median = [](std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        auto middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    };
+    Statistics statistics;
+    statistics.median = median(nsPerOp);
+    statistics.min = *std::min_element(nsPerOp.begin(), nsPerOp.end());
+    std::vector<double> deviations;
+    for (auto value : nsPerOp) {
+        deviations.push_back(std::abs(value - statistics.median));
+    }
+    statistics.spread = median(deviations) / statistics.median;
+    statistics.megahertz = median(megahertz);
+    return statistics;
+}
+
+// Run benchmarks of emulation hot paths and report time per operation and emulated clock speed,
+// to catch performance regressions and measure optimizations.
+int main(int argc, char** argv)
+{
+    try {
+        spdlog::set_level(spdlog::level::warn);
+        spdlog::set_pattern("[%H:%M:%S] %v");
+        auto options = parseOptions(argc, argv);
+
+        fmt::print("{:<28} {:>10} {:>10} {:>7} {:>10}\n", "benchmark", "ns/op", "min", "spread", "MHz");
+        size_t count = 0;
+        for (const auto& benchmark : makeBenchmarks(options)) {
+            if (benchmark.name.find(options.filter) == std::string::npos) {
+                continue;
+            }
+            auto statistics = measure(benchmark.setup(), options.samples);
+            auto megahertz = statistics.megahertz > 0 ? fmt::format("{:.1f}", statistics.megahertz) : "-";
+            fmt::print("{:<28} {:>10.2f} {:>10.2f} {:>6.1f}% {:>10}\n", benchmark.name, statistics.median, statistics.min,
+                100 * statistics.spread, megahertz);
+            ++count;
+        }
+        if (count == 0) {
+            throw std::runtime_error("No benchmarks match " + options.filter);
+        }
+        fmt::print("Game Boy CPU runs at 4.19 MHz, {} samples of at least {} ms each\n", options.samples, minSampleTime.count());
+        return 0;
+    } catch (const std::exception& e) {
+        spdlog::error(e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,249 @@
+#include "cartridge.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GBEMU_HAS_MMAP
+#endif
+
+static const size_t minimumRomSize = 2 * Cartridge::romBankSize;
+
+Rom::Rom(std::vector<uint8_t> data)
+    : buffer(std::move(data))
+{
+    // Banks are mapped whole, so the last one is padded to its full size.
+    auto size = (buffer.size() + Cartridge::romBankSize - 1) / Cartridge::romBankSize * Cartridge::romBankSize;
+    buffer.resize(std::max(size, minimumRomSize), 0);
+    bytes = buffer.data();
+    length = buffer.size();
+}
+
+Rom::~Rom()
+{
+#ifdef GBEMU_HAS_MMAP
+    if (isMapped) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+#endif
+}
+
+std::shared_ptr<const Rom> Rom::open(const std::string& path)
+{
+#ifdef GBEMU_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Couldn't open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+        auto size = static_cast<size_t>(info.st_size);
+        // Banks must be fully backed by the file, otherwise accessing them would fault.
+        if (size >= minimumRomSize && size % Cartridge::romBankSize == 0) {
+            void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (address != MAP_FAILED) {
+                close(fd);
+                std::shared_ptr<Rom> rom{ new Rom() };
+                rom->bytes = static_cast<const uint8_t*>(address);
+                rom->length = size;
+                rom->isMapped = true;
+                return rom;
+            }
+        }
+    }
+    close(fd);
+#endif
+    return std::make_shared<const Rom>(readFile(path));
+}
+
+Cartridge::Cartridge()
+    : Cartridge(std::make_shared<const Rom>(std::vector<uint8_t>{}))
+{
+}
+
+Cartridge::Cartridge(std::shared_ptr<const Rom> rom)
+    : rom(std::move(rom))
+{
+    const uint8_t* header = this->rom->data();
+    headerHash = hashBytes(gsl::make_span(header + 0x100, 0x50));
+    auto type = header[0x147];
+    switch (type) {
+    case 0x00: // ROM ONLY
+    case 0x08: // ROM+RAM
+    case 0x09: // ROM+RAM+BATTERY
+        mbc = Mbc::None;
+        break;
+    case 0x01: // MBC1
+    case 0x02: // MBC1+RAM
+    case 0x03: // MBC1+RAM+BATTERY
+        mbc = Mbc::Mbc1;
+        break;
+    case 0x0F: // MBC3+TIMER+BATTERY
+    case 0x10: // MBC3+TIMER+RAM+BATTERY
+    case 0x11: // MBC3
+    case 0x12: // MBC3+RAM
+    case 0x13: // MBC3+RAM+BATTERY
+        mbc = Mbc::Mbc3;
+        break;
+    case 0x19: // MBC5
+    case 0x1A: // MBC5+RAM
+    case 0x1B: // MBC5+RAM+BATTERY
+    case 0x1C: // MBC5+RUMBLE
+    case 0x1D: // MBC5+RUMBLE+RAM
+    case 0x1E: // MBC5+RUMBLE+RAM+BATTERY
+        mbc = Mbc::Mbc5;
+        break;
+    default:
+        spdlog::warn("Cartridge type 0x{:02x} not supported, treating it as ROM only.", type);
+        mbc = Mbc::None;
+    }
+
+    romBanks = (this->rom->size() + romBankSize - 1) / romBankSize;
+
+    switch (header[0x149]) {
+    case 0x01: // 2 KiB, rounded up to a full bank
+    case 0x02:
+        ramBanks = 1;
+        break;
+    case 0x03:
+        ramBanks = 4;
+        break;
+    case 0x04:
+        ramBanks = 16;
+        break;
+    case 0x05:
+        ramBanks = 8;
+        break;
+    default:
+        ramBanks = 0;
+    }
+    ram.resize(ramBanks * ramBankSize, 0);
+
+    // Cartridges without a memory bank controller have their RAM always enabled.
+    isRamEnabled = mbc == Mbc::None;
+    updateBanks();
+}
+
+uint8_t* Cartridge::getRamBank()
+{
+    if (!isRamEnabled || ramBanks == 0 || ramBank >= ramBanks) {
+        return nullptr;
+    }
+    return ram.data() + ramBank * ramBankSize;
+}
+
+void Cartridge::write(uint16_t address, uint8_t value)
+{
+    switch (mbc) {
+    case Mbc::None:
+        return;
+
+    case Mbc::Mbc1:
+        if (address < 0x2000) {
+            isRamEnabled = (value & 0x0F) == 0x0A;
+        } else if (address < 0x4000) {
+            romBankRegister = value & 0x1F;
+        } else if (address < 0x6000) {
+            ramBankRegister = value & 0x03;
+        } else {
+            isRamBankingMode = value & 0x01;
+        }
+        break;
+
+    case Mbc::Mbc3:
+        if (address < 0x2000) {
+            isRamEnabled = (value & 0x0F) == 0x0A;
+        } else if (address < 0x4000) {
+            romBankRegister = value & 0x7F;
+        } else if (address < 0x6000) {
+            ramBankRegister = value; // 0x08-0x0C select RTC registers, which are not emulated
+        }
+        break;
+
+    case Mbc::Mbc5:
+        if (address < 0x2000) {
+            isRamEnabled = (value & 0x0F) == 0x0A;
+        } else if (address < 0x3000) {
+            romBankRegister = static_cast<uint16_t>((romBankRegister & 0x100) | value);
+        } else if (address < 0x4000) {
+            romBankRegister = static_cast<uint16_t>((romBankRegister & 0xFF) | ((value & 0x01) << 8));
+        } else if (address < 0x6000) {
+            ramBankRegister = value & 0x0F;
+        }
+        break;
+    }
+    updateBanks();
+}
+
+void Cartridge::saveState(State& state, bool withRam) const
+{
+    state.headerHash = headerHash;
+    state.isRamEnabled = isRamEnabled;
+    state.romBankRegister = romBankRegister;
+    state.ramBankRegister = ramBankRegister;
+    state.isRamBankingMode = isRamBankingMode;
+    state.ramSize = static_cast<uint32_t>(ram.size());
+    if (withRam) {
+        std::copy(ram.begin(), ram.end(), state.ram.begin());
+    }
+}
+
+void Cartridge::loadState(const State& state)
+{
+    if (state.headerHash != headerHash || state.ramSize != ram.size()) {
+        throw std::runtime_error("State was saved from a different cartridge");
+    }
+    isRamEnabled = state.isRamEnabled;
+    romBankRegister = state.romBankRegister;
+    ramBankRegister = state.ramBankRegister;
+    isRamBankingMode = state.isRamBankingMode;
+    std::copy_n(state.ram.begin(), ram.size(), ram.begin());
+    updateBanks();
+}
+
+void Cartridge::updateBanks()
+{
+    switch (mbc) {
+    case Mbc::None:
+        romBank0 = 0;
+        romBank = 1;
+        ramBank = 0;
+        return;
+
+    case Mbc::Mbc1: {
+        // Bank 0 can't be selected in the switchable area, 0x20, 0x40 and 0x60 map to the bank after them.
+        size_t low = romBankRegister == 0 ? 1 : romBankRegister;
+        size_t high = static_cast<size_t>(ramBankRegister) << 5;
+        romBank = high | low;
+        romBank0 = isRamBankingMode ? high : 0;
+        ramBank = isRamBankingMode ? ramBankRegister : 0;
+        break;
+    }
+
+    case Mbc::Mbc3:
+        romBank = romBankRegister == 0 ? 1 : romBankRegister;
+        romBank0 = 0;
+        ramBank = ramBankRegister;
+        break;
+
+    case Mbc::Mbc5:
+        romBank = romBankRegister;
+        romBank0 = 0;
+        ramBank = ramBankRegister;
+        break;
+    }
+    romBank %= romBanks;
+    romBank0 %= romBanks;
+    bool isRtcSelected = mbc == Mbc::Mbc3 && ramBank >= 0x08;
+    if (ramBanks > 0 && !isRtcSelected) {
+        ramBank %= ramBanks;
+    }
+}
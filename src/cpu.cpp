@@ -8,7 +8,8 @@
 #include "fmt/format.h"
 #include "spdlog/spdlog.h"
 
-using json = nlohmann::json;
+// Times run() has to reach a block before it is compiled.
+static const unsigned compileThreshold = 16;
 
 Cpu::Cpu(Mmu& mmu, Timer& timer)
     : af(0)
@@ -17,12 +18,13 @@ Cpu::Cpu(Mmu& mmu, Timer& timer)
     , hl(0)
     , timer(timer)
     , mmu(mmu)
+    , ramBlocks(0x2000)
 {
 }
 
 std::string Cpu::toString() const
 {
-    return fmt::format("a={:02x} f={:04b} bc={:04x} de={:04x} hl={:04x} sp={:04x} pc={:04x} ", a, f >> 4, bc, de, hl, sp, pc);
+    return fmt::format("a={:02x} f={:04b} bc={:04x} de={:04x} hl={:04x} sp={:04x} pc={:04x} ", a, getF() >> 4, bc, de, hl, sp, pc);
 }
 
 std::ostream& operator<<(std::ostream& os, Cpu const& cpu)
@@ -30,63 +32,61 @@ std::ostream& operator<<(std::ostream& os, Cpu const& cpu)
     return os << cpu.toString();
 }
 
-bool isFlag(uint8_t flag)
-{
-    return flag == Cpu::flagZ || flag == Cpu::flagN || flag == Cpu::flagH || flag == Cpu::flagC;
-}
-
-void Cpu::setFlag(uint8_t flag, bool b)
-{
-    if (!isFlag(flag)) {
-        throw std::invalid_argument(fmt::format("{:02x} is not a flag value."));
-    }
-    b ? f |= flag : f &= ~flag;
-}
-
-bool Cpu::getFlag(uint8_t flag) const
-{
-    if (!isFlag(flag)) {
-        throw std::invalid_argument(fmt::format("{:02x} is not a flag value."));
+uint8_t Cpu::getF() const
+{
+    uint8_t flagsNH = f & (flagN | flagH);
+    switch (flagOp) {
+    case FlagOp::None:
+        break;
+    case FlagOp::Add:
+        flagsNH = flagIf(isHalfCarryAddition(static_cast<uint8_t>(flagX), static_cast<uint8_t>(flagY)), flagH);
+        break;
+    case FlagOp::Compare:
+        flagsNH = flagN | flagIf(isHalfCarrySubtraction(static_cast<int8_t>(flagX), static_cast<int8_t>(flagY)), flagH);
+        break;
+    case FlagOp::Inc:
+        flagsNH = flagIf(isHalfCarryAddition(static_cast<uint8_t>(flagX), 1), flagH);
+        break;
+    case FlagOp::Dec:
+        flagsNH = flagN | flagIf(isHalfCarrySubtraction(static_cast<int8_t>(flagX), 1), flagH);
+        break;
+    case FlagOp::AddHL:
+        flagsNH = flagIf(isHalfCarryAddition16(flagX, flagY), flagH);
+        break;
     }
-    return f & flag;
+    return static_cast<uint8_t>((f & 0x0F) | flagIf(zeroResult == 0, flagZ) | flagsNH | flagIf(carry, flagC));
 }
 
 void Cpu::rotateLeft(uint8_t& reg)
 {
-    bool oldFlagC = getFlag(flagC);
-    setFlag(flagC, reg >> 7);
-    reg <<= 1;
-    reg += oldFlagC;
-    setFlag(flagZ, reg == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 0);
+    uint8_t oldCarry = carry;
+    carry = reg >> 7;
+    reg = static_cast<uint8_t>((reg << 1) | oldCarry);
+    zeroResult = reg;
+    setFlagsNH(0);
 }
 
 void Cpu::shiftRight(uint8_t& reg)
 {
-    setFlag(flagC, reg & 0x1);
+    carry = reg & 0x1;
     reg >>= 1;
-    setFlag(flagZ, reg == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 0);
+    zeroResult = reg;
+    setFlagsNH(0);
 }
 
 void Cpu::rotateRight(uint8_t& reg)
 {
-    bool oldFlagC = getFlag(flagC);
-    setFlag(flagC, reg & 0x1);
-    reg >>= 1;
-    reg += oldFlagC << 7;
-    setFlag(flagZ, reg == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 0);
+    uint8_t oldCarry = carry;
+    carry = reg & 0x1;
+    reg = static_cast<uint8_t>((reg >> 1) | (oldCarry << 7));
+    zeroResult = reg;
+    setFlagsNH(0);
 }
 
 void Cpu::bit(uint8_t n, uint8_t byte)
 {
-    setFlag(flagZ, !isBitSet(n, byte));
-    setFlag(flagN, 0);
-    setFlag(flagH, 1);
+    zeroResult = isBitSet(n, byte);
+    setFlagsNH(flagH);
 }
 
 void Cpu::swap(uint8_t& reg)
@@ -94,36 +94,15 @@ void Cpu::swap(uint8_t& reg)
     uint8_t lower = reg & 0x0f;
     uint8_t upper = reg & 0xf0;
     reg = lower | upper;
-    setFlag(flagZ, reg == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 0);
-    setFlag(flagC, 0);
-}
-
-bool Cpu::executeExtended()
-{
-    uint8_t opcode = read();
-    switch (opcode) {
-    // clang-format off
-    case 0x11: rotateLeft(c);                                                      break; // RL C
-    case 0x19: rotateRight(c);                                                     break; // RR C
-    case 0x1A: rotateRight(d);                                                     break; // RR D
-    case 0x3F: shiftRight(a);                                                      break; // SRL A
-    case 0x37: swap(a);                                                            break; // SWAP A
-    case 0x38: shiftRight(b);                                                      break; // SRL B
-    case 0x7C: bit(7, h);                                                          break; // BIT 7,H
-    // clang-format on
-    default:
-        spdlog::error("Unimplemented opcode: CB {:02X}", opcode);
-        return false;
-    }
-
-    return true;
+    zeroResult = reg;
+    carry = false;
+    setFlagsNH(0);
 }
 
 uint8_t Cpu::read()
 {
-    return mmu.get(pc++);
+    ++pc;
+    return *operand++;
 }
 
 uint16_t Cpu::read16()
@@ -146,87 +125,83 @@ void Cpu::push(uint16_t nn)
     mmu.set(--sp, nn & 0xFF);
 }
 
-void Cpu::relativeJump(bool condition)
+void Cpu::relativeJump(bool condition, int takenCycles)
 {
     uint8_t offset = read();
     if (condition) {
         pc += static_cast<int8_t>(offset);
+        timer.increment(takenCycles);
     }
 }
 
-void Cpu::jump(bool condition)
+void Cpu::jump(bool condition, int takenCycles)
 {
     uint16_t target = read16();
     if (condition) {
         pc = target;
+        timer.increment(takenCycles);
     }
 }
 
-void Cpu::call(bool condition)
+void Cpu::call(bool condition, int takenCycles)
 {
     uint16_t target = read16();
     if (condition) {
         push(pc);
         pc = target;
+        timer.increment(takenCycles);
     }
 }
 
-void Cpu::ret(bool condition)
+void Cpu::ret(bool condition, int takenCycles)
 {
     if (condition) {
         pc = pop();
+        timer.increment(takenCycles);
     }
 }
 
 void Cpu::dec(uint8_t& reg)
 {
-    setFlag(flagH, isHalfCarrySubtraction(static_cast<int8_t>(reg), 1));
-    --reg;
-    setFlag(flagZ, reg == 0);
-    setFlag(flagN, 1);
+    setFlagOp(FlagOp::Dec, reg);
+    zeroResult = --reg;
 }
 
 void Cpu::inc(uint8_t& reg)
 {
-    setFlag(flagH, isHalfCarryAddition(reg, 1));
-    ++reg;
-    setFlag(flagZ, reg == 0);
-    setFlag(flagN, 0);
+    setFlagOp(FlagOp::Inc, reg);
+    zeroResult = ++reg;
 }
 
 void Cpu::xorA(uint8_t n)
 {
     a ^= n;
-    setFlag(flagZ, a == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 0);
-    setFlag(flagC, 0);
+    zeroResult = a;
+    carry = false;
+    setFlagsNH(0);
 }
 
 void Cpu::orA(uint8_t n)
 {
     a |= n;
-    setFlag(flagZ, a == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 0);
-    setFlag(flagC, 0);
+    zeroResult = a;
+    carry = false;
+    setFlagsNH(0);
 }
 
 void Cpu::andA(uint8_t n)
 {
     a &= n;
-    setFlag(flagZ, a == 0);
-    setFlag(flagN, 0);
-    setFlag(flagH, 1);
-    setFlag(flagC, 0);
+    zeroResult = a;
+    carry = false;
+    setFlagsNH(flagH);
 }
 
 void Cpu::cp(uint8_t n)
 {
-    setFlag(flagZ, a == n);
-    setFlag(flagH, isHalfCarrySubtraction(static_cast<int8_t>(a), static_cast<int8_t>(n)));
-    setFlag(flagC, a < n);
-    setFlag(flagN, 1);
+    setFlagOp(FlagOp::Compare, a, n);
+    zeroResult = a - n;
+    carry = a < n;
 }
 
 void Cpu::sub(uint8_t n)
@@ -237,31 +212,28 @@ void Cpu::sub(uint8_t n)
 
 void Cpu::add(uint8_t n)
 {
-    setFlag(flagH, isHalfCarryAddition(a, n));
-    setFlag(flagC, a + n > 0xff);
+    setFlagOp(FlagOp::Add, a, n);
+    carry = a + n > 0xff;
     a += n;
-    setFlag(flagZ, a == 0);
-    setFlag(flagN, 0);
+    zeroResult = a;
 }
 
 void Cpu::addHL(uint16_t nn)
 {
-    setFlag(flagH, isHalfCarryAddition16(hl, nn));
-    setFlag(flagC, hl + nn > 0xffff);
+    setFlagOp(FlagOp::AddHL, hl, nn);
+    carry = hl + nn > 0xffff;
     hl += nn;
-    setFlag(flagN, 0);
 }
 
 void Cpu::adc(uint8_t n)
 {
-    add(n + getFlag(flagC));
+    add(n + carry);
 }
 
 void Cpu::cpl()
 {
     a = ~a;
-    setFlag(flagN, 1);
-    setFlag(flagH, 1);
+    setFlagsNH(flagN | flagH);
 }
 
 void Cpu::rst(uint16_t target)
@@ -270,22 +242,61 @@ void Cpu::rst(uint16_t target)
     pc = target;
 }
 
-uint16_t Cpu::getAF() const { return af; }
+uint16_t Cpu::getAF() const { return concatBytes(getF(), a); }
 uint16_t Cpu::getBC() const { return bc; }
 uint16_t Cpu::getDE() const { return de; }
 uint16_t Cpu::getHL() const { return hl; }
 uint16_t Cpu::getSP() const { return sp; }
 uint16_t Cpu::getPC() const { return pc; }
 
-void Cpu::setAF(uint16_t nn) { af = nn; }
+void Cpu::setAF(uint16_t nn)
+{
+    af = nn;
+    zeroResult = ~f & flagZ;
+    carry = f & flagC;
+    flagOp = FlagOp::None;
+}
+
+void Cpu::saveState(State& state) const
+{
+    state.af = getAF();
+    state.bc = bc;
+    state.de = de;
+    state.hl = hl;
+    state.sp = sp;
+    state.pc = pc;
+    state.ime = ime;
+    state.isImeDelayed = imeDelayed.has_value();
+    state.imeDelayed = imeDelayed.value_or(false);
+    state.isHalted = isHalted;
+}
+
+void Cpu::loadState(const State& state)
+{
+    setAF(state.af);
+    bc = state.bc;
+    de = state.de;
+    hl = state.hl;
+    sp = state.sp;
+    pc = state.pc;
+    ime = state.ime;
+    imeDelayed = state.isImeDelayed ? std::optional<bool>{ state.imeDelayed } : std::nullopt;
+    isHalted = state.isHalted;
+    nonIdleJump = -1;
+    nextInstruction = blockEnd = nullptr;
+}
 
 void Cpu::handleInterrupts()
 {
+    if (ime == 0) {
+        return;
+    }
     auto interruptEnable = mmu.get(0xFFFF);
     auto interruptFlag = mmu.get(0xFF0F);
     for (uint8_t i = 0; i < 5; ++i) {
-        if (isBitSet(i, interruptFlag) && ime == 1 && isBitSet(i, interruptEnable)) {
+        if (isBitSet(i, interruptFlag) && isBitSet(i, interruptEnable)) {
             ime = 0;
+            isHalted = false;
             push(pc);
             pc = 0x40 + i * 0x8; // Jump to interrupt handler
             mmu.set(0xFF0F, interruptFlag & ~(1 << i)); // Reset interrupt flag
@@ -296,204 +307,543 @@ void Cpu::handleInterrupts()
     }
 }
 
-bool Cpu::execute()
+bool Cpu::isInterruptPending() const
 {
-    bool success = true;
+    return (mmu.get(0xFFFF) & mmu.get(0xFF0F) & 0x1F) != 0;
+}
+
+Cpu::IdleLoop Cpu::findIdleLoop(uint16_t jumpAddress) const
+{
+    switch (mmu.get(jumpAddress)) {
+    case 0x18: // JR n
+    case 0x20: // JR NZ,n
+    case 0x28: // JR Z,n
+    case 0x30: // JR NC,n
+    case 0x38: // JR C,n
+        break;
+    default:
+        return {};
+    }
+    uint16_t end = jumpAddress + 2;
+    if (static_cast<uint16_t>(end + static_cast<int8_t>(mmu.get(jumpAddress + 1))) != pc) {
+        return {};
+    }
 
+    // Each iteration must leave the same state behind: A is loaded from memory before it is
+    // modified, other instructions only set flags. The loop then only ends when memory changes.
+    IdleLoop loop{ end, 0, 0 };
+    bool isALoaded = false;
+    uint16_t address = pc;
+    while (address < jumpAddress) {
+        uint8_t opcode = mmu.get(address);
+        switch (opcode) {
+        case 0x0A: // LD A,(BC)
+        case 0x1A: // LD A,(DE)
+        case 0x7E: // LD A,(HL)
+        case 0xF0: // LDH A,(n)
+        case 0xFA: // LD A,(nn)
+            isALoaded = true;
+            break;
+        case 0xE6: // AND n
+            if (!isALoaded) {
+                return {};
+            }
+            break;
+        case 0xA7: // AND A
+        case 0xB7: // OR A
+        case 0xFE: // CP n
+            break;
+        default:
+            return {};
+        }
+        loop.cycles += opcodes[opcode].cycles;
+        loop.instructions += 1;
+        address += opcodes[opcode].length;
+    }
+    if (address != jumpAddress) {
+        return {};
+    }
+    uint8_t jump = mmu.get(jumpAddress);
+    loop.cycles += opcodeCycles[jump].base + opcodeCycles[jump].taken;
+    loop.instructions += 1;
+    return loop;
+}
+
+constexpr std::array<Cpu::Opcode, 256> Cpu::makeOpcodes()
+{
+    std::array<Opcode, 256> table{};
+    // clang-format off
+    table[0x00] = { [](Cpu&) {},                                                                           1 }; // NOP
+    table[0x01] = { [](Cpu& cpu) { cpu.bc = cpu.read16(); },                                               3 }; // LD BC,nn
+    table[0x02] = { [](Cpu& cpu) { cpu.mmu.set(cpu.bc, cpu.a); },                                          1 }; // LD (BC),A
+    table[0x03] = { [](Cpu& cpu) { ++cpu.bc; },                                                            1 }; // INC BC
+    table[0x04] = { [](Cpu& cpu) { cpu.inc(cpu.b); },                                                      1 }; // INC B
+    table[0x05] = { [](Cpu& cpu) { cpu.dec(cpu.b); },                                                      1 }; // DEC B
+    table[0x06] = { [](Cpu& cpu) { cpu.b = cpu.read(); },                                                  2 }; // LD B,n
+    table[0x0A] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(cpu.bc); },                                         1 }; // LD A,(BC)
+    table[0x0B] = { [](Cpu& cpu) { --cpu.bc; },                                                            1 }; // DEC BC
+    table[0x0C] = { [](Cpu& cpu) { cpu.inc(cpu.c); },                                                      1 }; // INC C
+    table[0x0D] = { [](Cpu& cpu) { cpu.dec(cpu.c); },                                                      1 }; // DEC C
+    table[0x0E] = { [](Cpu& cpu) { cpu.c = cpu.read(); },                                                  2 }; // LD C,n
+    table[0x11] = { [](Cpu& cpu) { cpu.de = cpu.read16(); },                                               3 }; // LD DE,nn
+    table[0x12] = { [](Cpu& cpu) { cpu.mmu.set(cpu.de, cpu.a); },                                          1 }; // LD (DE),A
+    table[0x13] = { [](Cpu& cpu) { ++cpu.de; },                                                            1 }; // INC DE
+    table[0x14] = { [](Cpu& cpu) { cpu.inc(cpu.d); },                                                      1 }; // INC D
+    table[0x15] = { [](Cpu& cpu) { cpu.dec(cpu.d); },                                                      1 }; // DEC D
+    table[0x16] = { [](Cpu& cpu) { cpu.d = cpu.read(); },                                                  2 }; // LD D,n
+    table[0x17] = { [](Cpu& cpu) { cpu.rotateLeft(cpu.a); },                                               1 }; // RLA
+    table[0x18] = { [](Cpu& cpu) { cpu.relativeJump(true); },                                              2 }; // JR n
+    table[0x19] = { [](Cpu& cpu) { cpu.addHL(cpu.de); },                                                   1 }; // ADD HL,DE
+    table[0x1A] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(cpu.de); },                                         1 }; // LD A,(DE)
+    table[0x1C] = { [](Cpu& cpu) { cpu.inc(cpu.e); },                                                      1 }; // INC E
+    table[0x1D] = { [](Cpu& cpu) { cpu.dec(cpu.e); },                                                      1 }; // DEC E
+    table[0x1E] = { [](Cpu& cpu) { cpu.e = cpu.read(); },                                                  2 }; // LD E,n
+    table[0x1F] = { [](Cpu& cpu) { cpu.rotateRight(cpu.a); },                                              1 }; // RRA
+    table[0x20] = { [](Cpu& cpu) { cpu.relativeJump(cpu.getFlag(flagZ) == 0, opcodeCycles[0x20].taken); }, 2 }; // JR NZ,n
+    table[0x21] = { [](Cpu& cpu) { cpu.hl = cpu.read16(); },                                               3 }; // LD HL,nn
+    table[0x22] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl++, cpu.a); },                                        1 }; // LD (HL+),A
+    table[0x23] = { [](Cpu& cpu) { ++cpu.hl; },                                                            1 }; // INC HL
+    table[0x24] = { [](Cpu& cpu) { cpu.inc(cpu.h); },                                                      1 }; // INC H
+    table[0x25] = { [](Cpu& cpu) { cpu.dec(cpu.h); },                                                      1 }; // DEC H
+    table[0x26] = { [](Cpu& cpu) { cpu.h = cpu.read(); },                                                  2 }; // LD H,n
+    table[0x28] = { [](Cpu& cpu) { cpu.relativeJump(cpu.getFlag(flagZ) == 1, opcodeCycles[0x28].taken); }, 2 }; // JR Z,n
+    table[0x29] = { [](Cpu& cpu) { cpu.addHL(cpu.hl); },                                                   1 }; // ADD HL,HL
+    table[0x2A] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(cpu.hl++); },                                       1 }; // LD A,(HL+)
+    table[0x2C] = { [](Cpu& cpu) { cpu.inc(cpu.l); },                                                      1 }; // INC L
+    table[0x2D] = { [](Cpu& cpu) { cpu.dec(cpu.l); },                                                      1 }; // DEC L
+    table[0x2E] = { [](Cpu& cpu) { cpu.l = cpu.read(); },                                                  2 }; // LD L,n
+    table[0x2F] = { [](Cpu& cpu) { cpu.cpl(); },                                                           1 }; // CPL
+    table[0x30] = { [](Cpu& cpu) { cpu.relativeJump(cpu.getFlag(flagC) == 0, opcodeCycles[0x30].taken); }, 2 }; // JR NC,n
+    table[0x31] = { [](Cpu& cpu) { cpu.sp = cpu.read16(); },                                               3 }; // LD SP,nn
+    table[0x32] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl--, cpu.a); },                                        1 }; // LDD (HL),A
+    table[0x33] = { [](Cpu& cpu) { ++cpu.sp; },                                                            1 }; // INC SP
+    table[0x34] = { [](Cpu& cpu) { ++cpu.hl; },                                                            1 }; // INC HL
+    table[0x35] = { [](Cpu& cpu) { auto n = cpu.mmu.get(cpu.hl); cpu.dec(n); cpu.mmu.set(cpu.hl, n); },    1 }; // DEC (HL)
+    table[0x36] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.read()); },                                     2 }; // LD (HL),n
+    table[0x37] = { [](Cpu& cpu) { cpu.carry = true; cpu.setFlagsNH(0); },                                 1 }; // SCF
+    table[0x38] = { [](Cpu& cpu) { cpu.relativeJump(cpu.getFlag(flagC) == 1, opcodeCycles[0x38].taken); }, 2 }; // JR C,n
+    table[0x39] = { [](Cpu& cpu) { cpu.addHL(cpu.sp); },                                                   1 }; // ADD HL,SP
+    table[0x3A] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(cpu.hl--); },                                       1 }; // LD A,(HL-)
+    table[0x3C] = { [](Cpu& cpu) { cpu.inc(cpu.a); },                                                      1 }; // INC A
+    table[0x3D] = { [](Cpu& cpu) { cpu.dec(cpu.a); },                                                      1 }; // DEC A
+    table[0x3E] = { [](Cpu& cpu) { cpu.a = cpu.read(); },                                                  2 }; // LD A,n
+    table[0x40] = { [](Cpu& cpu) { cpu.b = cpu.b; },                                                       1 }; // LD B,B
+    table[0x41] = { [](Cpu& cpu) { cpu.b = cpu.c; },                                                       1 }; // LD B,C
+    table[0x42] = { [](Cpu& cpu) { cpu.b = cpu.d; },                                                       1 }; // LD B,D
+    table[0x43] = { [](Cpu& cpu) { cpu.b = cpu.e; },                                                       1 }; // LD B,E
+    table[0x44] = { [](Cpu& cpu) { cpu.b = cpu.h; },                                                       1 }; // LD B,H
+    table[0x45] = { [](Cpu& cpu) { cpu.b = cpu.l; },                                                       1 }; // LD B,L
+    table[0x46] = { [](Cpu& cpu) { cpu.b = cpu.mmu.get(cpu.hl); },                                         1 }; // LD B,(HL)
+    table[0x47] = { [](Cpu& cpu) { cpu.b = cpu.a; },                                                       1 }; // LD B,A
+    table[0x48] = { [](Cpu& cpu) { cpu.c = cpu.b; },                                                       1 }; // LD C,B
+    table[0x49] = { [](Cpu& cpu) { cpu.c = cpu.c; },                                                       1 }; // LD C,C
+    table[0x4A] = { [](Cpu& cpu) { cpu.c = cpu.d; },                                                       1 }; // LD C,D
+    table[0x4B] = { [](Cpu& cpu) { cpu.c = cpu.e; },                                                       1 }; // LD C,E
+    table[0x4C] = { [](Cpu& cpu) { cpu.c = cpu.h; },                                                       1 }; // LD C,H
+    table[0x4D] = { [](Cpu& cpu) { cpu.c = cpu.l; },                                                       1 }; // LD C,L
+    table[0x4E] = { [](Cpu& cpu) { cpu.c = cpu.mmu.get(cpu.hl); },                                         1 }; // LD C,B
+    table[0x4F] = { [](Cpu& cpu) { cpu.c = cpu.a; },                                                       1 }; // LD C,A
+    table[0x50] = { [](Cpu& cpu) { cpu.d = cpu.b; },                                                       1 }; // LD D,B
+    table[0x51] = { [](Cpu& cpu) { cpu.d = cpu.c; },                                                       1 }; // LD D,C
+    table[0x52] = { [](Cpu& cpu) { cpu.d = cpu.d; },                                                       1 }; // LD D,D
+    table[0x53] = { [](Cpu& cpu) { cpu.d = cpu.e; },                                                       1 }; // LD D,E
+    table[0x54] = { [](Cpu& cpu) { cpu.d = cpu.h; },                                                       1 }; // LD D,H
+    table[0x55] = { [](Cpu& cpu) { cpu.d = cpu.l; },                                                       1 }; // LD D,L
+    table[0x56] = { [](Cpu& cpu) { cpu.d = cpu.mmu.get(cpu.hl); },                                         1 }; // LD D,(HL)
+    table[0x57] = { [](Cpu& cpu) { cpu.d = cpu.a; },                                                       1 }; // LD D,A
+    table[0x58] = { [](Cpu& cpu) { cpu.e = cpu.b; },                                                       1 }; // LD E,B
+    table[0x59] = { [](Cpu& cpu) { cpu.e = cpu.c; },                                                       1 }; // LD E,C
+    table[0x5A] = { [](Cpu& cpu) { cpu.e = cpu.d; },                                                       1 }; // LD E,D
+    table[0x5B] = { [](Cpu& cpu) { cpu.e = cpu.e; },                                                       1 }; // LD E,E
+    table[0x5C] = { [](Cpu& cpu) { cpu.e = cpu.h; },                                                       1 }; // LD E,H
+    table[0x5D] = { [](Cpu& cpu) { cpu.e = cpu.l; },                                                       1 }; // LD E,L
+    table[0x5E] = { [](Cpu& cpu) { cpu.e = cpu.mmu.get(cpu.hl); },                                         1 }; // LD E,(HL)
+    table[0x5F] = { [](Cpu& cpu) { cpu.e = cpu.a; },                                                       1 }; // LD E,A
+    table[0x60] = { [](Cpu& cpu) { cpu.h = cpu.b; },                                                       1 }; // LD H,B
+    table[0x61] = { [](Cpu& cpu) { cpu.h = cpu.c; },                                                       1 }; // LD H,C
+    table[0x62] = { [](Cpu& cpu) { cpu.h = cpu.d; },                                                       1 }; // LD H,D
+    table[0x63] = { [](Cpu& cpu) { cpu.h = cpu.e; },                                                       1 }; // LD H,E
+    table[0x64] = { [](Cpu& cpu) { cpu.h = cpu.h; },                                                       1 }; // LD H,H
+    table[0x65] = { [](Cpu& cpu) { cpu.h = cpu.l; },                                                       1 }; // LD H,L
+    table[0x66] = { [](Cpu& cpu) { cpu.h = cpu.mmu.get(cpu.hl); },                                         1 }; // LD H,(HL)
+    table[0x67] = { [](Cpu& cpu) { cpu.h = cpu.a; },                                                       1 }; // LD H,A
+    table[0x68] = { [](Cpu& cpu) { cpu.l = cpu.b; },                                                       1 }; // LD L,B
+    table[0x69] = { [](Cpu& cpu) { cpu.l = cpu.c; },                                                       1 }; // LD L,C
+    table[0x6A] = { [](Cpu& cpu) { cpu.l = cpu.d; },                                                       1 }; // LD L,D
+    table[0x6B] = { [](Cpu& cpu) { cpu.l = cpu.e; },                                                       1 }; // LD L,E
+    table[0x6C] = { [](Cpu& cpu) { cpu.l = cpu.h; },                                                       1 }; // LD L,H
+    table[0x6D] = { [](Cpu& cpu) { cpu.l = cpu.l; },                                                       1 }; // LD L,L
+    table[0x6E] = { [](Cpu& cpu) { cpu.l = cpu.mmu.get(cpu.hl); },                                         1 }; // LD L,(HL)
+    table[0x6F] = { [](Cpu& cpu) { cpu.l = cpu.a; },                                                       1 }; // LD L,A
+    table[0x70] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.b); },                                          1 }; // LD (HL),B
+    table[0x71] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.c); },                                          1 }; // LD (HL),C
+    table[0x72] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.d); },                                          1 }; // LD (HL),D
+    table[0x73] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.e); },                                          1 }; // LD (HL),E
+    table[0x74] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.h); },                                          1 }; // LD (HL),H
+    table[0x75] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.l); },                                          1 }; // LD (HL),L
+    table[0x76] = { [](Cpu& cpu) { cpu.isHalted = !cpu.isInterruptPending(); },                            1 }; // HALT
+    table[0x77] = { [](Cpu& cpu) { cpu.mmu.set(cpu.hl, cpu.a); },                                          1 }; // LD (HL),A
+    table[0x78] = { [](Cpu& cpu) { cpu.a = cpu.b; },                                                       1 }; // LD A,B
+    table[0x79] = { [](Cpu& cpu) { cpu.a = cpu.c; },                                                       1 }; // LD A,C
+    table[0x7A] = { [](Cpu& cpu) { cpu.a = cpu.d; },                                                       1 }; // LD A,D
+    table[0x7B] = { [](Cpu& cpu) { cpu.a = cpu.e; },                                                       1 }; // LD A,E
+    table[0x7C] = { [](Cpu& cpu) { cpu.a = cpu.h; },                                                       1 }; // LD A,H
+    table[0x7D] = { [](Cpu& cpu) { cpu.a = cpu.l; },                                                       1 }; // LD A,L
+    table[0x7E] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(cpu.hl); },                                         1 }; // LD A,(HL)
+    table[0x7F] = { [](Cpu& cpu) { cpu.a = cpu.a; },                                                       1 }; // LD A,A
+    table[0x86] = { [](Cpu& cpu) { cpu.add(cpu.mmu.get(cpu.hl)); },                                        1 }; // ADD A,(HL)
+    table[0x87] = { [](Cpu& cpu) { cpu.add(cpu.a); },                                                      1 }; // ADD A,A
+    table[0x90] = { [](Cpu& cpu) { cpu.sub(cpu.b); },                                                      1 }; // SUB B
+    table[0xA1] = { [](Cpu& cpu) { cpu.andA(cpu.c); },                                                     1 }; // AND C
+    table[0xA7] = { [](Cpu& cpu) { cpu.andA(cpu.a); },                                                     1 }; // AND A
+    table[0xA8] = { [](Cpu& cpu) { cpu.xorA(cpu.b); },                                                     1 }; // XOR B
+    table[0xA9] = { [](Cpu& cpu) { cpu.xorA(cpu.c); },                                                     1 }; // XOR C
+    table[0xAA] = { [](Cpu& cpu) { cpu.xorA(cpu.d); },                                                     1 }; // XOR D
+    table[0xAB] = { [](Cpu& cpu) { cpu.xorA(cpu.e); },                                                     1 }; // XOR E
+    table[0xAC] = { [](Cpu& cpu) { cpu.xorA(cpu.h); },                                                     1 }; // XOR H
+    table[0xAD] = { [](Cpu& cpu) { cpu.xorA(cpu.l); },                                                     1 }; // XOR L
+    table[0xAE] = { [](Cpu& cpu) { cpu.xorA(cpu.mmu.get(cpu.hl)); },                                       1 }; // XOR (HL)
+    table[0xAF] = { [](Cpu& cpu) { cpu.xorA(cpu.a); },                                                     1 }; // XOR A
+    table[0xB0] = { [](Cpu& cpu) { cpu.orA(cpu.b); },                                                      1 }; // OR B
+    table[0xB1] = { [](Cpu& cpu) { cpu.orA(cpu.c); },                                                      1 }; // OR C
+    table[0xB2] = { [](Cpu& cpu) { cpu.orA(cpu.d); },                                                      1 }; // OR D
+    table[0xB3] = { [](Cpu& cpu) { cpu.orA(cpu.e); },                                                      1 }; // OR E
+    table[0xB4] = { [](Cpu& cpu) { cpu.orA(cpu.h); },                                                      1 }; // OR H
+    table[0xB5] = { [](Cpu& cpu) { cpu.orA(cpu.l); },                                                      1 }; // OR L
+    table[0xB6] = { [](Cpu& cpu) { cpu.orA(cpu.mmu.get(cpu.hl)); },                                        1 }; // OR (HL)
+    table[0xB7] = { [](Cpu& cpu) { cpu.orA(cpu.a); },                                                      1 }; // OR A
+    table[0xBE] = { [](Cpu& cpu) { cpu.cp(cpu.mmu.get(cpu.hl)); },                                         1 }; // CP (HL)
+    table[0xC0] = { [](Cpu& cpu) { cpu.ret(cpu.getFlag(flagZ) == 0, opcodeCycles[0xC0].taken); },          1 }; // RET NZ
+    table[0xC1] = { [](Cpu& cpu) { cpu.bc = cpu.pop(); },                                                  1 }; // POP BC
+    table[0xC3] = { [](Cpu& cpu) { cpu.jump(true); },                                                      3 }; // JP nn
+    table[0xC4] = { [](Cpu& cpu) { cpu.call(cpu.getFlag(flagZ) == 0, opcodeCycles[0xC4].taken); },         3 }; // CALL NZ,nn
+    table[0xC6] = { [](Cpu& cpu) { cpu.add(cpu.read()); },                                                 2 }; // ADD A,n
+    table[0xC8] = { [](Cpu& cpu) { cpu.ret(cpu.getFlag(flagZ) == 1, opcodeCycles[0xC8].taken); },          1 }; // RET Z
+    table[0xC9] = { [](Cpu& cpu) { cpu.ret(true); },                                                       1 }; // RET
+    table[0xC5] = { [](Cpu& cpu) { cpu.push(cpu.bc); },                                                    1 }; // PUSH BC
+    table[0xCA] = { [](Cpu& cpu) { cpu.jump(cpu.getFlag(flagZ) == 1, opcodeCycles[0xCA].taken); },         3 }; // JP Z
+    table[0xCC] = { [](Cpu& cpu) { cpu.call(cpu.getFlag(flagZ) == 1, opcodeCycles[0xCC].taken); },         3 }; // CALL Z,nn
+    table[0xCD] = { [](Cpu& cpu) { cpu.call(true); },                                                      3 }; // CALL nn
+    table[0xCE] = { [](Cpu& cpu) { cpu.adc(cpu.read()); },                                                 2 }; // ADC A,n
+    table[0xD0] = { [](Cpu& cpu) { cpu.ret(cpu.getFlag(flagC) == 0, opcodeCycles[0xD0].taken); },          1 }; // RET NC
+    table[0xD1] = { [](Cpu& cpu) { cpu.de = cpu.pop(); },                                                  1 }; // POP DE
+    table[0xD4] = { [](Cpu& cpu) { cpu.call(cpu.getFlag(flagC) == 0, opcodeCycles[0xD4].taken); },         3 }; // CALL NC,nn
+    table[0xD5] = { [](Cpu& cpu) { cpu.push(cpu.de); },                                                    1 }; // PUSH DE
+    table[0xD6] = { [](Cpu& cpu) { cpu.sub(cpu.read()); },                                                 2 }; // SUB N
+    table[0xD8] = { [](Cpu& cpu) { cpu.ret(cpu.getFlag(flagC) == 1, opcodeCycles[0xD8].taken); },          1 }; // RET C
+    table[0xD9] = { [](Cpu& cpu) { cpu.imeDelayed = 1; cpu.ret(true); },                                   1 }; // RETI
+    table[0xDC] = { [](Cpu& cpu) { cpu.call(cpu.getFlag(flagC) == 1, opcodeCycles[0xDC].taken); },         3 }; // CALL C,nn
+    table[0xE0] = { [](Cpu& cpu) { cpu.mmu.set(0xFF00 + cpu.read(), cpu.a); },                             2 }; // LDH ($FF00+n),A
+    table[0xE1] = { [](Cpu& cpu) { cpu.hl = cpu.pop(); },                                                  1 }; // POP HL
+    table[0xE2] = { [](Cpu& cpu) { cpu.mmu.set(0xFF00 + cpu.c, cpu.a); },                                  1 }; // LD ($FF00+C),A
+    table[0xE5] = { [](Cpu& cpu) { cpu.push(cpu.hl); },                                                    1 }; // PUSH HL
+    table[0xE6] = { [](Cpu& cpu) { cpu.andA(cpu.read()); },                                                2 }; // AND n
+    table[0xE9] = { [](Cpu& cpu) { cpu.pc = cpu.mmu.get(cpu.hl); },                                        1 }; // JP (HL)
+    table[0xEA] = { [](Cpu& cpu) { cpu.mmu.set(cpu.read16(), cpu.a); },                                    3 }; // LD ($nn),A
+    table[0xEE] = { [](Cpu& cpu) { cpu.xorA(cpu.read()); },                                                2 }; // XOR n
+    table[0xEF] = { [](Cpu& cpu) { cpu.rst(0x0028); },                                                     1 }; // RST 28H
+    table[0xF0] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(0xFF00 + cpu.read()); },                            2 }; // LDH A,(n)
+    table[0xF1] = { [](Cpu& cpu) { cpu.setAF(cpu.pop()); },                                                1 }; // POP AF
+    table[0xF3] = { [](Cpu& cpu) { cpu.imeDelayed = 0; },                                                  1 }; // DI
+    table[0xF5] = { [](Cpu& cpu) { cpu.push(cpu.getAF()); },                                               1 }; // PUSH AF
+    table[0xF6] = { [](Cpu& cpu) { cpu.orA(cpu.read()); },                                                 2 }; // OR n
+    table[0xFA] = { [](Cpu& cpu) { cpu.a = cpu.mmu.get(cpu.read16()); },                                   3 }; // LD A,(nn)
+    table[0xFB] = { [](Cpu& cpu) { cpu.imeDelayed = 1; },                                                  1 }; // EI
+    table[0xFE] = { [](Cpu& cpu) { cpu.cp(cpu.read()); },                                                  2 }; // CP n
+    table[0xFF] = { [](Cpu& cpu) { cpu.rst(0x0038); },                                                     1 }; // RST 38H
+    // clang-format on
+    for (auto opcode = 0u; opcode < table.size(); ++opcode) {
+        table[opcode].cycles = opcodeCycles[opcode].base;
+    }
+    return table;
+}
+
+constexpr std::array<Cpu::Opcode, 256> Cpu::makeExtendedOpcodes()
+{
+    std::array<Opcode, 256> table{};
+    // clang-format off
+    table[0x11] = { [](Cpu& cpu) { cpu.rotateLeft(cpu.c); },                                               2 }; // RL C
+    table[0x19] = { [](Cpu& cpu) { cpu.rotateRight(cpu.c); },                                              2 }; // RR C
+    table[0x1A] = { [](Cpu& cpu) { cpu.rotateRight(cpu.d); },                                              2 }; // RR D
+    table[0x3F] = { [](Cpu& cpu) { cpu.shiftRight(cpu.a); },                                               2 }; // SRL A
+    table[0x37] = { [](Cpu& cpu) { cpu.swap(cpu.a); },                                                     2 }; // SWAP A
+    table[0x38] = { [](Cpu& cpu) { cpu.shiftRight(cpu.b); },                                               2 }; // SRL B
+    table[0x7C] = { [](Cpu& cpu) { cpu.bit(7, cpu.h); },                                                   2 }; // BIT 7,H
+    // clang-format on
+    for (auto opcode = 0u; opcode < table.size(); ++opcode) {
+        table[opcode].cycles = extendedOpcodeCycles[opcode];
+    }
+    return table;
+}
+
+const std::array<Cpu::Opcode, 256> Cpu::opcodes = Cpu::makeOpcodes();
+const std::array<Cpu::Opcode, 256> Cpu::extendedOpcodes = Cpu::makeExtendedOpcodes();
+
+bool Cpu::execute()
+{
     handleInterrupts();
     if (imeDelayed.has_value()) {
         ime = imeDelayed.value();
         imeDelayed = {};
     }
+    if (isHalted) {
+        if (!isInterruptPending()) {
+            timer.increment(4);
+            return true;
+        }
+        isHalted = false;
+    }
 
-    timer.increment(getCycles(mmu.get(pc), mmu.get(pc + 1), getFlag(flagZ), getFlag(flagC)));
-
-    uint8_t opcode = read();
-    switch (opcode) {
-    // clang-format off
-    case 0x00:                                                                     break; // NOP
-    case 0x01: bc = read16();                                                      break; // LD BC,nn
-    case 0x02: mmu.set(bc, a);                                                     break; // LD (BC),A
-    case 0x03: ++bc;                                                               break; // INC BC
-    case 0x04: inc(b);                                                             break; // INC B
-    case 0x05: dec(b);                                                             break; // DEC B
-    case 0x06: b = read();                                                         break; // LD B,n
-    case 0x0A: a = mmu.get(bc);                                                    break; // LD A,(BC)
-    case 0x0B: --bc;                                                               break; // DEC BC
-    case 0x0C: inc(c);                                                             break; // INC C
-    case 0x0D: dec(c);                                                             break; // DEC C
-    case 0x0E: c = read();                                                         break; // LD C,n
-    case 0x11: de = read16();                                                      break; // LD DE,nn
-    case 0x12: mmu.set(de, a);                                                     break; // LD (DE),A
-    case 0x13: ++de;                                                               break; // INC DE
-    case 0x14: inc(d);                                                             break; // INC D
-    case 0x15: dec(d);                                                             break; // DEC D
-    case 0x16: d = read();                                                         break; // LD D,n
-    case 0x17: rotateLeft(a);                                                      break; // RLA
-    case 0x18: relativeJump(true);                                                 break; // JR n
-    case 0x19: addHL(de);                                                          break; // ADD HL,DE
-    case 0x1A: a = mmu.get(de);                                                    break; // LD A,(DE)
-    case 0x1C: inc(e);                                                             break; // INC E
-    case 0x1D: dec(e);                                                             break; // DEC E
-    case 0x1E: e = read();                                                         break; // LD E,n
-    case 0x1F: rotateRight(a);                                                     break; // RRA
-    case 0x20: relativeJump(getFlag(flagZ) == 0);                                  break; // JR NZ,n
-    case 0x21: hl = read16();                                                      break; // LD HL,nn
-    case 0x22: mmu.set(hl++, a);                                                   break; // LD (HL+),A
-    case 0x23: ++hl;                                                               break; // INC HL
-    case 0x24: inc(h);                                                             break; // INC H
-    case 0x25: dec(h);                                                             break; // DEC H
-    case 0x26: h = read();                                                         break; // LD H,n
-    case 0x28: relativeJump(getFlag(flagZ) == 1);                                  break; // JR Z,n
-    case 0x29: addHL(hl);                                                          break; // ADD HL,HL
-    case 0x2A: a = mmu.get(hl++);                                                  break; // LD A,(HL+)
-    case 0x2C: inc(l);                                                             break; // INC L
-    case 0x2D: dec(l);                                                             break; // DEC L
-    case 0x2E: l = read();                                                         break; // LD L,n
-    case 0x2F: cpl();                                                              break; // CPL
-    case 0x30: relativeJump(getFlag(flagC) == 0);                                  break; // JR NC,n
-    case 0x31: sp = read16();                                                      break; // LD SP,nn
-    case 0x32: mmu.set(hl--, a);                                                   break; // LDD (HL),A
-    case 0x33: ++sp;                                                               break; // INC SP
-    case 0x34: ++hl;                                                               break; // INC HL
-    case 0x35: { auto n = mmu.get(hl); dec(n); mmu.set(hl, n); }                   break; // DEC (HL)
-    case 0x36: mmu.set(hl, read());                                                break; // LD (HL),n
-    case 0x37: setFlag(flagN, 0); setFlag(flagH, 0); setFlag(flagC, 1);            break; // SCF
-    case 0x38: relativeJump(getFlag(flagC) == 1);                                  break; // JR C,n
-    case 0x39: addHL(sp);                                                          break; // ADD HL,SP
-    case 0x3A: a = mmu.get(hl--);                                                  break; // LD A,(HL-)
-    case 0x3C: inc(a);                                                             break; // INC A
-    case 0x3D: dec(a);                                                             break; // DEC A
-    case 0x3E: a = read();                                                         break; // LD A,n
-    case 0x40: b = b;                                                              break; // LD B,B
-    case 0x41: b = c;                                                              break; // LD B,C
-    case 0x42: b = d;                                                              break; // LD B,D
-    case 0x43: b = e;                                                              break; // LD B,E
-    case 0x44: b = h;                                                              break; // LD B,H
-    case 0x45: b = l;                                                              break; // LD B,L
-    case 0x46: b = mmu.get(hl);                                                    break; // LD B,(HL)
-    case 0x47: b = a;                                                              break; // LD B,A
-    case 0x48: c = b;                                                              break; // LD C,B
-    case 0x49: c = c;                                                              break; // LD C,C
-    case 0x4A: c = d;                                                              break; // LD C,D
-    case 0x4B: c = e;                                                              break; // LD C,E
-    case 0x4C: c = h;                                                              break; // LD C,H
-    case 0x4D: c = l;                                                              break; // LD C,L
-    case 0x4E: c = mmu.get(hl);                                                    break; // LD C,B
-    case 0x4F: c = a;                                                              break; // LD C,A
-    case 0x50: d = b;                                                              break; // LD D,B
-    case 0x51: d = c;                                                              break; // LD D,C
-    case 0x52: d = d;                                                              break; // LD D,D
-    case 0x53: d = e;                                                              break; // LD D,E
-    case 0x54: d = h;                                                              break; // LD D,H
-    case 0x55: d = l;                                                              break; // LD D,L
-    case 0x56: d = mmu.get(hl);                                                    break; // LD D,(HL)
-    case 0x57: d = a;                                                              break; // LD D,A
-    case 0x58: e = b;                                                              break; // LD E,B
-    case 0x59: e = c;                                                              break; // LD E,C
-    case 0x5A: e = d;                                                              break; // LD E,D
-    case 0x5B: e = e;                                                              break; // LD E,E
-    case 0x5C: e = h;                                                              break; // LD E,H
-    case 0x5D: e = l;                                                              break; // LD E,L
-    case 0x5E: e = mmu.get(hl);                                                    break; // LD E,(HL)
-    case 0x5F: e = a;                                                              break; // LD E,A
-    case 0x60: h = b;                                                              break; // LD H,B
-    case 0x61: h = c;                                                              break; // LD H,C
-    case 0x62: h = d;                                                              break; // LD H,D
-    case 0x63: h = e;                                                              break; // LD H,E
-    case 0x64: h = h;                                                              break; // LD H,H
-    case 0x65: h = l;                                                              break; // LD H,L
-    case 0x66: h = mmu.get(hl);                                                    break; // LD H,(HL)
-    case 0x67: h = a;                                                              break; // LD H,A
-    case 0x68: l = b;                                                              break; // LD L,B
-    case 0x69: l = c;                                                              break; // LD L,C
-    case 0x6A: l = d;                                                              break; // LD L,D
-    case 0x6B: l = e;                                                              break; // LD L,E
-    case 0x6C: l = h;                                                              break; // LD L,H
-    case 0x6D: l = l;                                                              break; // LD L,L
-    case 0x6E: l = mmu.get(hl);                                                    break; // LD L,(HL)
-    case 0x6F: l = a;                                                              break; // LD L,A
-    case 0x70: mmu.set(hl, b);                                                     break; // LD (HL),B
-    case 0x71: mmu.set(hl, c);                                                     break; // LD (HL),C
-    case 0x72: mmu.set(hl, d);                                                     break; // LD (HL),D
-    case 0x73: mmu.set(hl, e);                                                     break; // LD (HL),E
-    case 0x74: mmu.set(hl, h);                                                     break; // LD (HL),H
-    case 0x75: mmu.set(hl, l);                                                     break; // LD (HL),L
-    case 0x77: mmu.set(hl, a);                                                     break; // LD (HL),A
-    case 0x78: a = b;                                                              break; // LD A,B
-    case 0x79: a = c;                                                              break; // LD A,C
-    case 0x7A: a = d;                                                              break; // LD A,D
-    case 0x7B: a = e;                                                              break; // LD A,E
-    case 0x7C: a = h;                                                              break; // LD A,H
-    case 0x7D: a = l;                                                              break; // LD A,L
-    case 0x7E: a = mmu.get(hl);                                                    break; // LD A,(HL)
-    case 0x7F: a = a;                                                              break; // LD A,A
-    case 0x86: add(mmu.get(hl));                                                   break; // ADD A,(HL)
-    case 0x87: add(a);                                                             break; // ADD A,A
-    case 0x90: sub(b);                                                             break; // SUB B
-    case 0xA1: andA(c);                                                            break; // AND C
-    case 0xA7: andA(a);                                                            break; // AND A
-    case 0xA8: xorA(b);                                                            break; // XOR B
-    case 0xA9: xorA(c);                                                            break; // XOR C
-    case 0xAA: xorA(d);                                                            break; // XOR D
-    case 0xAB: xorA(e);                                                            break; // XOR E
-    case 0xAC: xorA(h);                                                            break; // XOR H
-    case 0xAD: xorA(l);                                                            break; // XOR L
-    case 0xAE: xorA(mmu.get(hl));                                                  break; // XOR (HL)
-    case 0xAF: xorA(a);                                                            break; // XOR A
-    case 0xB0: orA(b);                                                             break; // OR B
-    case 0xB1: orA(c);                                                             break; // OR C
-    case 0xB2: orA(d);                                                             break; // OR D
-    case 0xB3: orA(e);                                                             break; // OR E
-    case 0xB4: orA(h);                                                             break; // OR H
-    case 0xB5: orA(l);                                                             break; // OR L
-    case 0xB6: orA(mmu.get(hl));                                                   break; // OR (HL)
-    case 0xB7: orA(a);                                                             break; // OR A
-    case 0xBE: cp(mmu.get(hl));                                                    break; // CP (HL)
-    case 0xC0: ret(getFlag(flagZ) == 0);                                           break; // RET NZ
-    case 0xC1: bc = pop();                                                         break; // POP BC
-    case 0xC3: jump(true);                                                         break; // JP nn
-    case 0xC4: call(getFlag(flagZ) == 0);                                          break; // CALL NZ,nn
-    case 0xC6: add(read());                                                        break; // ADD A,n
-    case 0xC8: ret(getFlag(flagZ) == 1);                                           break; // RET Z
-    case 0xC9: ret(true);                                                          break; // RET
-    case 0xC5: push(bc);                                                           break; // PUSH BC
-    case 0xCA: jump(getFlag(flagZ) == 1);                                          break; // JP Z
-    case 0xCB: success = executeExtended();                                        break;
-    case 0xCC: call(getFlag(flagZ) == 1);                                          break; // CALL Z,nn
-    case 0xCD: call(true);                                                         break; // CALL nn
-    case 0xCE: adc(read());                                                        break; // ADC A,n
-    case 0xD0: ret(getFlag(flagC) == 0);                                           break; // RET NC
-    case 0xD1: de = pop();                                                         break; // POP DE
-    case 0xD4: call(getFlag(flagC) == 0);                                          break; // CALL NC,nn
-    case 0xD5: push(de);                                                           break; // PUSH DE
-    case 0xD6: sub(read());                                                        break; // SUB N
-    case 0xD8: ret(getFlag(flagC) == 1);                                           break; // RET C
-    case 0xD9: imeDelayed = 1; ret(true);                                          break; // RETI
-    case 0xDC: call(getFlag(flagC) == 1);                                          break; // CALL C,nn
-    case 0xE0: mmu.set(0xFF00 + read(), a);                                        break; // LDH ($FF00+n),A
-    case 0xE1: hl = pop();                                                         break; // POP HL
-    case 0xE2: mmu.set(0xFF00 + c, a);                                             break; // LD ($FF00+C),A
-    case 0xE5: push(hl);                                                           break; // PUSH HL
-    case 0xE6: andA(read());                                                       break; // AND n
-    case 0xE9: pc = mmu.get(hl);                                                   break; // JP (HL)
-    case 0xEA: mmu.set(read16(), a);                                               break; // LD ($nn),A
-    case 0xEE: xorA(read());                                                       break; // XOR n
-    case 0xEF: rst(0x0028);                                                        break; // RST 28H
-    case 0xF0: a = mmu.get(0xFF00 + read());                                       break; // LDH A,(n)
-    case 0xF1: setAF(pop());                                                       break; // POP AF
-    case 0xF3: imeDelayed = 0;                                                     break; // DI
-    case 0xF5: push(getAF());                                                      break; // PUSH AF
-    case 0xF6: orA(read());                                                        break; // OR n
-    case 0xFA: a = mmu.get(read16());                                              break; // LD A,(nn)
-    case 0xFB: imeDelayed = 1;                                                     break; // EI
-    case 0xFE: cp(read());                                                         break; // CP n
-    case 0xFF: rst(0x0038);                                                        break; // RST 38H
-    // clang-format on
-    default:
-        spdlog::error("Unimplemented opcode: {:02X}", opcode);
+    const DecodedInstruction& instruction = fetch();
+    if (!instruction.execute) {
+        if (instruction.opcodeLength == 2) {
+            spdlog::error("Unimplemented opcode: CB {:02X}", mmu.get(pc + 1));
+        } else {
+            spdlog::error("Unimplemented opcode: {:02X}", mmu.get(pc));
+        }
+        pc += instruction.opcodeLength;
         return false;
     }
 
-    return success;
+    pc += instruction.opcodeLength;
+    operand = instruction.operands.data();
+    timer.increment(instruction.cycles);
+    instruction.execute(*this);
+    return true;
+}
+
+const Cpu::DecodedInstruction& Cpu::fetch()
+{
+    if (nextInstruction != blockEnd && nextInstruction->address == pc && blockEpoch == mmu.getCodeEpoch()) {
+        return *nextInstruction++;
+    }
+    nextInstruction = blockEnd = nullptr;
+    Block* block = getBlock(pc);
+    if (block && !block->instructions.empty()) {
+        nextInstruction = block->instructions.data();
+        blockEnd = nextInstruction + block->instructions.size();
+        blockEpoch = mmu.getCodeEpoch();
+        return *nextInstruction++;
+    }
+    uncachedInstruction = decode(pc);
+    return uncachedInstruction;
+}
+
+Cpu::Block* Cpu::getBlock(uint16_t address)
+{
+    if (address >= 0x8000 && (address < 0xC000 || address >= 0xE000)) {
+        return nullptr;
+    }
+    std::unique_ptr<Block>* slot;
+    if (address < 0x8000) {
+        auto bank = mmu.getRomBankNumber(address);
+        if (bank >= romBlocks.size()) {
+            romBlocks.resize(bank + 1);
+        }
+        auto& bankBlocks = romBlocks[bank];
+        if (bankBlocks.empty()) {
+            bankBlocks.resize(Cartridge::romBankSize);
+        }
+        slot = &bankBlocks[address % Cartridge::romBankSize];
+    } else {
+        slot = &ramBlocks[address - 0xC000];
+    }
+    auto& block = *slot;
+    if (!block || block->page != mmu.getPage(address) || block->version != mmu.getCodeVersion(address)) {
+        block = decodeBlock(address);
+    }
+    return block.get();
+}
+
+uint32_t Cpu::runCompiled(uint64_t end, uint16_t& lastPC)
+{
+    // Compiled code doesn't service interrupts or run EI, DI, RETI and HALT. Work RAM code is left
+    // to the interpreter, as it may be modified by the code itself.
+    if (pc >= 0x8000 || isHalted || imeDelayed || (ime && isInterruptPending())) {
+        return 0;
+    }
+    Block* block = getBlock(pc);
+    if (!block->compiled) {
+        // Code run only a few times isn't worth compiling.
+        if (!block->isCompilable || block->entries++ != compileThreshold) {
+            return 0;
+        }
+        std::vector<JitInstruction> instructions;
+        for (const auto& instruction : block->instructions) {
+            auto opcode = mmu.get(instruction.address);
+            if (opcode == 0xFB || opcode == 0xF3 || opcode == 0xD9 || opcode == 0x76) {
+                break;
+            }
+            instructions.push_back({ instruction.execute, instruction.address, instruction.opcodeLength, instruction.operands.data() });
+        }
+        if (instructions.empty()) {
+            // Nothing to compile, the compiler's nullptr would look like full code memory.
+            block->isCompilable = false;
+            return 0;
+        }
+        auto compiled = jit->compile(instructions);
+        if (!compiled) {
+            // Code memory is used up, mostly by blocks decoded again since. Start over with empty memory.
+            spdlog::debug("JIT code memory is full, dropping compiled code.");
+            clearCompiled();
+            jit->clear();
+            compiled = jit->compile(instructions);
+        }
+        if (!compiled) {
+            spdlog::warn("JIT couldn't allocate code memory, continuing with the interpreter.");
+            setJitEnabled(false);
+            return 0;
+        }
+        block->compiled = compiled;
+        block->compiledLength = static_cast<uint32_t>(instructions.size());
+    }
+
+    // Run the instructions which start before the end of the budget. Branches taken add more
+    // cycles, but compiled code stops after them.
+    uint64_t now = timer.getCycles();
+    uint32_t limit = 0;
+    while (limit < block->compiledLength && now < end) {
+        now += block->instructions[limit++].cycles;
+    }
+    jitContext.entryEpoch = mmu.getCodeEpoch();
+    jitContext.limit = limit;
+    jitContext.interruptMask = ime ? 0x1F : 0;
+    uint32_t executed = block->compiled(&jitContext);
+    if (executed == 0) {
+        return 0;
+    }
+
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < executed; ++i) {
+        cycles += block->instructions[i].cycles;
+    }
+    timer.increment(cycles);
+    lastPC = block->instructions[executed - 1].address;
+    return executed;
+}
+
+Cpu::DecodedInstruction Cpu::decode(uint16_t address) const
+{
+    uint8_t opcode = mmu.get(address);
+    const Opcode* op = &opcodes[opcode];
+    uint8_t opcodeLength = 1;
+    if (opcode == 0xCB) {
+        op = &extendedOpcodes[mmu.get(address + 1)];
+        opcodeLength = 2;
+    }
+    uint16_t operands = address + opcodeLength;
+    return { op->execute, address, opcodeLength, op->cycles, { mmu.get(operands), mmu.get(operands + 1) } };
+}
+
+std::unique_ptr<Cpu::Block> Cpu::decodeBlock(uint16_t start)
+{
+    auto block = std::make_unique<Block>();
+    block->page = mmu.getPage(start);
+    block->version = mmu.getCodeVersion(start);
+    const unsigned pageEnd = (start | 0xFF) + 1u;
+    for (uint16_t address = start; address != pageEnd;) {
+        auto instruction = decode(address);
+        uint8_t opcode = mmu.get(address);
+        auto length = opcode == 0xCB ? extendedOpcodes[mmu.get(address + 1)].length : opcodes[opcode].length;
+        if (!instruction.execute || address + length > pageEnd) {
+            break;
+        }
+        block->instructions.push_back(instruction);
+        address += length;
+        // JR n, JP nn, RET, RETI, JP (HL), RST n and HALT don't continue with the next instruction.
+        if (opcode == 0x18 || opcode == 0xC3 || opcode == 0xC9 || opcode == 0xD9 || opcode == 0xE9 || (opcode & 0xC7) == 0xC7 || opcode == 0x76) {
+            break;
+        }
+    }
+    mmu.watchCode(start);
+    return block;
+}
+
+void Cpu::clearCompiled()
+{
+    auto clear = [](std::vector<std::unique_ptr<Block>>& blocks) {
+        for (auto& block : blocks) {
+            if (block) {
+                block->compiled = nullptr;
+                block->entries = 0;
+            }
+        }
+    };
+    for (auto& bankBlocks : romBlocks) {
+        clear(bankBlocks);
+    }
+    clear(ramBlocks);
+}
+
+bool Cpu::setJitEnabled(bool enabled)
+{
+    if (!enabled || !JitCompiler::isSupported()) {
+        clearCompiled();
+        jit.reset();
+        return !enabled;
+    }
+    if (!jit) {
+        jit = std::make_unique<JitCompiler>();
+        jitContext = { this, &pc, &operand, &mmu.getCodeEpoch(), mmu.getPage(0xFF00) + 0x0F, mmu.getPage(0xFF00) + 0xFF, 0, 0, 0 };
+    }
+    return true;
+}
+
+RunResult Cpu::run(uint64_t cycleBudget, std::optional<uint16_t> breakpoint)
+{
+    // The budget end, breakpoint and counters are kept in locals. Handlers advance the timer and
+    // registers directly, so the cycle count is read back from the timer every iteration.
+    const uint64_t start = timer.getCycles();
+    const uint64_t end = start + cycleBudget;
+    const int stopPC = breakpoint ? *breakpoint : -1;
+    uint64_t instructions = 0;
+    StopReason reason = StopReason::Budget;
+    // The first iteration of an idle loop may have read memory before the run started, so a loop
+    // is only skipped once a whole iteration ran since the previous time it was found.
+    int idleLoopStart = -1;
+    uint64_t idleLoopFoundAt = 0;
+    while (timer.getCycles() < end) {
+        if (pc == stopPC) {
+            reason = StopReason::Breakpoint;
+            break;
+        }
+        if (isHalted && !isInterruptPending() && !imeDelayed) {
+            // Interrupts are only requested by events handled between runs, sleep until the end.
+            timer.increment((end - timer.getCycles() + 3) & ~uint64_t{ 3 });
+            break;
+        }
+        uint16_t instructionPC = pc;
+        uint32_t compiledInstructions = jit && stopPC < 0 ? runCompiled(end, instructionPC) : 0;
+        if (compiledInstructions != 0) {
+            instructions += compiledInstructions;
+        } else {
+            if (!execute()) {
+                reason = StopReason::UnimplementedOpcode;
+                break;
+            }
+            ++instructions;
+        }
+        // Polling loops are a few bytes long.
+        if (pc < instructionPC && instructionPC - pc <= 6 && instructionPC != nonIdleJump) {
+            auto loop = findIdleLoop(instructionPC);
+            if (loop.cycles == 0) {
+                nonIdleJump = instructionPC;
+                continue;
+            }
+            // Skip whole iterations while nothing can change the memory the loop polls, or raise
+            // an interrupt. The CPU ends up in the same state as if it ran them.
+            bool isIterationComplete = pc == idleLoopStart && instructions - idleLoopFoundAt == loop.instructions;
+            bool isBreakpointInLoop = stopPC >= pc && stopPC < loop.end;
+            bool canInterrupt = imeDelayed || (ime && isInterruptPending());
+            auto now = timer.getCycles();
+            if (isIterationComplete && !isBreakpointInLoop && !canInterrupt && now < end) {
+                uint64_t iterations = (end - now) / loop.cycles;
+                timer.increment(iterations * loop.cycles);
+                instructions += iterations * loop.instructions;
+            }
+            idleLoopStart = pc;
+            idleLoopFoundAt = instructions;
+        }
+    }
+    return { timer.getCycles() - start, instructions, reason };
 }
@@ -35,6 +35,10 @@ Debugger::Debugger(const Emulator& emulator, QWidget* parent)
     QShortcut* shortcutStepFrame = new QShortcut(Qt::Key_F9, this);
     QObject::connect(shortcutStepFrame, &QShortcut::activated, this, &Debugger::on_buttonStepFrame_clicked);
 
+    ui->buttonRewindFrame->setIcon(style()->standardIcon(QStyle::SP_MediaSeekBackward));
+    QShortcut* shortcutRewindFrame = new QShortcut(Qt::Key_F8, this);
+    QObject::connect(shortcutRewindFrame, &QShortcut::activated, this, &Debugger::on_buttonRewindFrame_clicked);
+
     QRegExp regex("[0-9a-fA-F]{0,4}");
     QValidator* validator = new QRegExpValidator(regex, this);
     ui->textBreakpointPC->setValidator(validator);
@@ -63,11 +67,13 @@ void Debugger::redraw()
     setRegisterLabel(ui->valueSP, cpu.getSP());
     setRegisterLabel(ui->valuePC, cpu.getPC());
 
-    Instruction instr = disassemble(emulator.getMmu().getMemory(), cpu.getPC());
-    auto nextInstructionStr = fmt::format("{} {}", instr.mnemonic, instr.operandsToString());
+    char operands[32];
+    char bytes[16];
+    Instruction instr = disassemble(emulator.getMmu(), cpu.getPC());
+    auto nextInstructionStr = fmt::format("{} {}", instr.mnemonic(), formatOperands(instr, operands));
     ui->labelInstruction->setText(QString::fromStdString(nextInstructionStr));
 
-    auto nextBytesStr = fmt::format("{}", instr.bytesToString());
+    auto nextBytesStr = fmt::format("{}", formatBytes(instr, bytes));
     ui->labelBytes->setText(QString::fromStdString(nextBytesStr));
 }
 
@@ -104,6 +110,11 @@ void Debugger::on_buttonStepFrame_clicked()
     emit stepFrameClicked();
 }
 
+void Debugger::on_buttonRewindFrame_clicked()
+{
+    emit rewindFrameClicked();
+}
+
 void Debugger::onEmulationPaused()
 {
     paused = true;
@@ -3,7 +3,7 @@
 #include <exception>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <iterator>
 #include <stdexcept>
 #include <vector>
 
@@ -16,11 +16,17 @@ int main(int argc, char** argv)
             throw std::runtime_error("Please provide rom name.");
         }
         auto rom = readFile(argv[1]);
+        BufferReader reader{ rom };
+        char operands[32];
+        char bytes[16];
+        fmt::memory_buffer line;
         uint16_t pc = 0u;
         while (pc < rom.size()) {
-            Instruction instr = disassemble(rom, pc);
-            std::cout << fmt::format("{:<6} {:<15} ; {:04x} ; {}", instr.mnemonic, instr.operandsToString(), instr.pc, instr.bytesToString()) << std::endl;
-            pc += instr.bytes.size();
+            Instruction instr = disassemble(reader, pc);
+            line.clear();
+            fmt::format_to(std::back_inserter(line), "{:<6} {:<15} ; {:04x} ; {}\n", instr.mnemonic(), formatOperands(instr, operands), instr.pc, formatBytes(instr, bytes));
+            std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+            pc += instr.length;
         }
         return 0;
     } catch (const std::exception& e) {
@@ -18,53 +18,114 @@
 #include <QSettings>
 #include <QTimer>
 
-Emulator::Emulator(const std::string& romFilename)
-    : mmu()
-    , timer()
-    , cpu(mmu, timer)
-    , gpu(mmu, timer)
+Emulator::Emulator(const std::string& romFilename, const std::string& movieFilename)
+    : rom(Rom::open(romFilename))
+    , machine(readFile("../gbemu/res/bootstrap.bin"), rom)
+    , movieFilename(movieFilename)
 {
-    auto bootstrapRom = readFile("../gbemu/res/bootstrap.bin");
-    mmu.loadBootstrap(bootstrapRom);
-    auto cartridgeRom = readFile(romFilename);
-    mmu.loadCartridge(cartridgeRom);
     qtimer = new QTimer(this);
+    if (!movieFilename.empty()) {
+        recorder.emplace(machine, *rom);
+    }
 }
 
 Emulator::~Emulator()
 {
     delete qtimer;
+    if (recorder) {
+        try {
+            auto movie = recorder->getMovie(machine);
+            auto data = serializeMovie(movie);
+            writeFile(movieFilename, data);
+            spdlog::info("Saved movie of {} frames to {}.", movie.frames.size(), movieFilename);
+        } catch (const std::exception& e) {
+            spdlog::error(e.what());
+        }
+    }
+}
+
+void Emulator::beginFrame()
+{
+    if (startedFrame == machine.getFrameCount()) {
+        return;
+    }
+    startedFrame = machine.getFrameCount();
+    rewind.push(machine);
+    machine.getMmu().setJoypad(joypad);
+    if (recorder) {
+        recorder->record(machine);
+    }
 }
 
 void Emulator::emulateFrame()
 {
-    bool isFrameFinished = false;
-    while (!isFrameFinished) {
-        if (cpu.getPC() == breakpoint) {
-            pause();
-            return;
+    beginFrame();
+
+    // Tracing logs every instruction, otherwise the whole frame runs inside the CPU loop.
+    if (spdlog::default_logger()->level() <= spdlog::level::trace) {
+        bool isFrameFinished = false;
+        while (!isFrameFinished) {
+            if (getCpu().getPC() == breakpoint) {
+                pause();
+                return;
+            }
+            isFrameFinished = executeInstruction();
         }
-        isFrameFinished = executeInstruction();
+        emit frameFinished();
+        return;
+    }
+
+    switch (machine.runFrame(breakpoint)) {
+    case StepResult::Breakpoint:
+        pause();
+        return;
+    case StepResult::Stopped:
+        pause();
+        break;
+    case StepResult::Executed:
+    case StepResult::FrameFinished:
+        break;
     }
     emit frameFinished();
 }
 
 bool Emulator::executeInstruction()
 {
-    auto previousPC = cpu.getPC();
-    if (cpu.execute()) {
+    beginFrame();
+    auto previousPC = getCpu().getPC();
+    auto result = machine.step();
+    if (result != StepResult::Stopped) {
         if (spdlog::default_logger()->level() <= spdlog::level::trace) {
-            Instruction instr = disassemble(mmu.getMemory(), previousPC);
-            spdlog::trace("{:04x} {:<10} {:<6} {:<13} {}", instr.pc, instr.bytesToString(), instr.mnemonic, instr.operandsToString(), cpu.toString());
+            char operands[32];
+            char bytes[16];
+            Instruction instr = disassemble(getMmu(), previousPC);
+            spdlog::trace("{:04x} {:<10} {:<6} {:<13} {}", instr.pc, formatBytes(instr, bytes), instr.mnemonic(), formatOperands(instr, operands), getCpu().toString());
         }
     } else {
-        Instruction instr = disassemble(mmu.getMemory(), previousPC);
-        spdlog::info("{:04x} {:<10} {:<6} {:<13}", instr.pc, instr.bytesToString(), instr.mnemonic, instr.operandsToString());
+        char operands[32];
+        char bytes[16];
+        Instruction instr = disassemble(getMmu(), previousPC);
+        spdlog::info("{:04x} {:<10} {:<6} {:<13}", instr.pc, formatBytes(instr, bytes), instr.mnemonic(), formatOperands(instr, operands));
         pause();
         return true;
     }
-    return gpu.step();
+    return result == StepResult::FrameFinished;
+}
+
+void Emulator::rewindFrame()
+{
+    if (rewind.rewind(machine)) {
+        // The restored frame starts again, input recorded after it is dropped when it does.
+        startedFrame.reset();
+        emit frameFinished();
+    }
 }
+
+void Emulator::setJoypad(uint8_t buttons)
+{
+    joypad = buttons;
+}
+
 void Emulator::play()
 {
     spdlog::info("Starting emulation.");
@@ -97,8 +158,12 @@ int runGui(int argc, char** argv)
 {
     QApplication app(argc, argv);
     auto romFilename = argv[1];
+    std::string movieFilename;
+    if (argc >= 4 && std::string(argv[2]) == "--record") {
+        movieFilename = argv[3];
+    }
 
-    Emulator emulator{ romFilename };
+    Emulator emulator{ romFilename, movieFilename };
     Screen screen{ emulator };
     Debugger debugger{ emulator, &screen };
     VramView vramView{ emulator, &screen };
@@ -107,12 +172,14 @@ int runGui(int argc, char** argv)
     QObject::connect(&debugger, &Debugger::playClicked, &emulator, &Emulator::play);
     QObject::connect(&debugger, &Debugger::stepClicked, &emulator, &Emulator::executeInstruction);
     QObject::connect(&debugger, &Debugger::stepFrameClicked, &emulator, &Emulator::emulateFrame);
+    QObject::connect(&debugger, &Debugger::rewindFrameClicked, &emulator, &Emulator::rewindFrame);
     QObject::connect(&debugger, &Debugger::breakpointSet, &emulator, &Emulator::breakpointSet);
     QObject::connect(&debugger, &Debugger::breakpointUnset, &emulator, &Emulator::breakpointUnset);
 
     QObject::connect(&emulator, &Emulator::emulationPaused, &debugger, &Debugger::onEmulationPaused);
     QObject::connect(&emulator, &Emulator::emulationResumed, &debugger, &Debugger::onEmulationResumed);
 
+    QObject::connect(&screen, &Screen::joypadChanged, &emulator, &Emulator::setJoypad);
     QObject::connect(&emulator, &Emulator::frameFinished, &screen, &Screen::redraw);
     QObject::connect(&emulator, &Emulator::frameFinished, &vramView, &VramView::redraw);
     screen.redraw();
@@ -1,23 +1,66 @@
 #include "gpu.h"
 
+#include <algorithm>
+#include <array>
+
 #include <spdlog/spdlog.h>
 
-Gpu::Gpu(Mmu& mmu, Timer& timer)
+static const uint8_t visiblePixelsX = Gpu::screenWidth;
+static const uint8_t visiblePixelsY = Gpu::screenHeight;
+
+// Mode durations in clock cycles.
+static const uint64_t oamAccessCycles = 80;
+static const uint64_t vramAccessCycles = 172;
+static const uint64_t hblankCycles = 204;
+static const uint64_t vblankLineCycles = 456;
+
+Gpu::Gpu(Mmu& mmu, Scheduler& scheduler)
     : mmu(mmu)
-    , timer(timer)
+    , scheduler(scheduler)
+    , framebuffer(visiblePixelsX, visiblePixelsY)
 {
+    colorIndices.fill(notRendered);
+    enterMode(Mode::HBlank, hblankCycles);
 }
 
-static const uint8_t visiblePixelsX = 160;
-static const uint8_t visiblePixelsY = 144;
+void Gpu::saveState(State& state, bool withColorIndices) const
+{
+    state.mode = mode;
+    state.modeEnd = modeEnd;
+    if (withColorIndices) {
+        state.colorIndices = colorIndices;
+    }
+}
+
+void Gpu::loadState(const State& state)
+{
+    mode = state.mode;
+    modeEnd = state.modeEnd;
+    colorIndices = state.colorIndices;
+    // Lines are always rendered whole.
+    for (auto y = 0u; y < visiblePixelsY; ++y) {
+        const uint8_t* line = &colorIndices[y * visiblePixelsX];
+        if (line[0] == notRendered) {
+            std::fill_n(framebuffer.getData() + y * visiblePixelsX * bytesPerPixel, visiblePixelsX * bytesPerPixel, 0);
+        } else {
+            framebuffer.drawScanline(line, y);
+        }
+    }
+}
+
+void Gpu::enterMode(Mode newMode, uint64_t cycles)
+{
+    // Durations add up from the previous deadline, so instructions overshooting it don't delay the GPU.
+    mode = newMode;
+    modeEnd += cycles;
+    scheduler.schedule(Event::GpuModeEnd, modeEnd);
+}
 
 void Gpu::drawTile(Image& image, uint tileIndex, uint tileX, uint tileY, uint8_t scx, uint8_t scy) const
 {
+    const Tile& tile = mmu.getTile(tileIndex);
     for (uint8_t line = 0u; line < linesPerTile; ++line) {
-        auto index = static_cast<uint16_t>(2 * (line + linesPerTile * tileIndex)); // location of tile data in vram
-        auto byte1 = mmu.getVram().at(index);
-        auto byte0 = mmu.getVram().at(index + 1);
-        image.drawLine(byte0, byte1, tileX, tileY, scx, scy, line);
+        image.drawLine(tile[line], tileX, tileY, scx, scy, line);
     }
 }
 
@@ -26,12 +69,10 @@ Image Gpu::getTileData() const
     static const auto tilesPerRow = 16u;
     static const auto tilesPerColumn = 32u;
 
+    // Only the top 24 rows have tiles, the bottom of VRAM holds background maps.
     Image image{ tilesPerRow * pixelsPerLine, tilesPerColumn * linesPerTile };
-    for (auto tileY = 0u; tileY < tilesPerColumn; ++tileY) {
-        for (auto tileX = 0u; tileX < tilesPerRow; ++tileX) {
-            auto tileIndex = tileX + tilesPerRow * tileY;
-            drawTile(image, tileIndex, tileX, tileY, 0, 0);
-        }
+    for (auto tileIndex = 0u; tileIndex < TileCache::tileCount; ++tileIndex) {
+        drawTile(image, tileIndex, tileIndex % tilesPerRow, tileIndex / tilesPerRow, 0, 0);
     }
     return image;
 }
@@ -66,84 +107,82 @@ Image Gpu::getBgMap() const
     return image;
 }
 
-Image Gpu::getScreenBuffer() const
+void Gpu::renderScanline()
 {
     static const auto tilesPerRow = 32u;
-    static const auto tilesPerColumn = 32u;
+    static const auto bgMapOffset = 0x1800u; // or 0x1C00
 
+    auto ly = mmu.get(0xff44);
+    if (ly >= visiblePixelsY) {
+        return;
+    }
+    auto scx = mmu.get(0xff43);
+    auto scy = mmu.get(0xff42);
     auto vram = mmu.getVram();
-    Image image{ visiblePixelsX, visiblePixelsY };
-    for (auto tileY = 0u; tileY < tilesPerColumn; ++tileY) {
-        for (auto tileX = 0u; tileX < tilesPerRow; ++tileX) {
-            auto tileOffset = tileY * tilesPerRow + tileX; // tile offset in bg map
-            auto bgMapOffset = 0x1800u; // or 0x1C00
-            auto tileIndex = vram[bgMapOffset + tileOffset]; // index of tile to draw here
-            drawTile(image, tileIndex, tileX, tileY, mmu.get(0xff43), mmu.get(0xff42));
-        }
+
+    // Background is 256x256 pixels and wraps around.
+    auto y = static_cast<uint8_t>(ly + scy);
+    auto line = y % linesPerTile;
+    auto mapRow = bgMapOffset + (y / linesPerTile) * tilesPerRow;
+    auto firstTileX = scx / pixelsPerLine;
+    auto fineX = static_cast<unsigned int>(scx % pixelsPerLine);
+
+    // 21 tiles cover the visible line when it doesn't start at a tile boundary.
+    std::array<uint8_t, visiblePixelsX + pixelsPerLine> colors;
+    for (auto tile = 0u; tile * pixelsPerLine < visiblePixelsX + fineX; ++tile) {
+        auto tileIndex = vram[mapRow + (firstTileX + tile) % tilesPerRow];
+        const TileLine& tileLine = mmu.getTile(tileIndex)[line];
+        std::copy(tileLine.begin(), tileLine.end(), colors.begin() + tile * pixelsPerLine);
     }
-    return image;
+    uint8_t* lineIndices = &colorIndices[ly * visiblePixelsX];
+    std::copy_n(colors.data() + fineX, visiblePixelsX, lineIndices);
+    framebuffer.drawScanline(lineIndices, ly);
 }
 
-bool Gpu::step()
+bool Gpu::endMode()
 {
     static const int lineAddress = 0xff44;
-    int clock = timer.getCycles();
     switch (mode) {
 
     // OAM read mode, scanline active
     case Mode::OamAccess:
-        if (clock >= 80) {
-            // Enter scanline mode 3
-            timer.reset();
-            mode = Mode::VramAccress;
-        }
+        // Enter scanline mode 3
+        enterMode(Mode::VramAccress, vramAccessCycles);
         break;
 
     // VRAM read mode, scanline active
     // Treat end of mode 3 as end of scanline
     case Mode::VramAccress:
-        if (clock >= 172) {
-            // Enter hblank
-            timer.reset();
-            mode = Mode::HBlank;
-
-            // Write a scanline to the framebuffer
-            //            renderscan();
-        }
+        // Write a scanline to the framebuffer
+        renderScanline();
+        enterMode(Mode::HBlank, hblankCycles);
         break;
 
     // Hblank
-    // After the last hblank, push the screen data to canvas
     case Mode::HBlank:
-        if (clock >= 204) {
-            timer.reset();
-            mmu.set(lineAddress, mmu.get(lineAddress) + 1);
-
-            if (mmu.get(lineAddress) == 143) {
-                // Enter vblank
-                mode = Mode::VBlank;
-                mmu.set(0xFF0F, 1); // VBlank interrupt
-                //                GPU._canvas.putImageData(GPU._scrn, 0, 0);
-            } else {
-                mode = Mode::OamAccess;
-            }
+        mmu.set(lineAddress, mmu.get(lineAddress) + 1);
+
+        if (mmu.get(lineAddress) == visiblePixelsY) {
+            // Enter vblank
+            mmu.set(0xFF0F, 1); // VBlank interrupt
+            enterMode(Mode::VBlank, vblankLineCycles);
+        } else {
+            enterMode(Mode::OamAccess, oamAccessCycles);
         }
         break;
 
     // Vblank (10 lines)
     case Mode::VBlank:
-        if (clock >= 456) {
-            timer.reset();
-            mmu.set(lineAddress, mmu.get(lineAddress) + 1);
-
-            if (mmu.get(lineAddress) > 153) {
-                spdlog::trace("VBlank done.");
-                // Restart scanning modes
-                mode = Mode::OamAccess;
-                mmu.set(lineAddress, 0);
-                return true;
-            }
+        mmu.set(lineAddress, mmu.get(lineAddress) + 1);
+
+        if (mmu.get(lineAddress) > 153) {
+            spdlog::trace("VBlank done.");
+            // Restart scanning modes
+            mmu.set(lineAddress, 0);
+            enterMode(Mode::OamAccess, oamAccessCycles);
+            return true;
         }
+        enterMode(Mode::VBlank, vblankLineCycles);
         break;
     }
     return false;
@@ -0,0 +1,148 @@
+#include "machine.h"
+#include "movie.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "utils.h"
+
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+static const char* usage = "Usage: gbemu-headless [--frames n] [--until-pc address] [--bootstrap path] [--jit] [--load-state path] [--save-state path] [--rewind MiB] [--replay movie] rom";
+
+struct Options {
+    std::string romFilename;
+    std::string bootstrapFilename = "../gbemu/res/bootstrap.bin"; // Same as emulator
+    std::optional<uint64_t> frames; // 60, or the end of the replayed movie
+    std::optional<uint16_t> untilPc;
+    bool jit = false;
+    std::string loadStateFilename;
+    std::string saveStateFilename;
+    size_t rewindBudget = 0; // Bytes, rewind history isn't recorded if 0
+    std::string replayFilename;
+};
+
+static Options parseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(fmt::format("Missing value for {}.\n{}", arg, usage));
+            }
+            return argv[++i];
+        };
+        if (arg == "--frames") {
+            options.frames = std::stoull(value());
+        } else if (arg == "--until-pc") {
+            options.untilPc = static_cast<uint16_t>(std::stoul(value(), nullptr, 16));
+        } else if (arg == "--bootstrap") {
+            options.bootstrapFilename = value();
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg == "--load-state") {
+            options.loadStateFilename = value();
+        } else if (arg == "--save-state") {
+            options.saveStateFilename = value();
+        } else if (arg == "--rewind") {
+            options.rewindBudget = std::stoull(value()) << 20;
+        } else if (arg == "--replay") {
+            options.replayFilename = value();
+        } else if (options.romFilename.empty() && arg[0] != '-') {
+            options.romFilename = arg;
+        } else {
+            throw std::runtime_error(fmt::format("Unknown argument {}.\n{}", arg, usage));
+        }
+    }
+    if (options.romFilename.empty()) {
+        throw std::runtime_error(usage);
+    }
+    if (!options.replayFilename.empty() && !options.loadStateFilename.empty()) {
+        throw std::runtime_error("Movies start from their own state, --replay can't be used with --load-state.");
+    }
+    return options;
+}
+
+// Run ROM without user interface until frame count or PC is reached, then print final state hashes.
+// Exit code is 2 if the CPU stopped on an unimplemented opcode.
+int main(int argc, char** argv)
+{
+    try {
+        spdlog::set_level(spdlog::level::info);
+        spdlog::set_pattern("[%H:%M:%S] %v");
+        auto options = parseOptions(argc, argv);
+
+        auto rom = Rom::open(options.romFilename);
+        Machine machine{ readFile(options.bootstrapFilename), rom };
+        if (options.jit && !machine.getCpu().setJitEnabled(true)) {
+            spdlog::warn("JIT is not supported on this host, using the interpreter.");
+        }
+        // Frame count is part of the state, so --frames counts from power on.
+        auto state = std::make_unique<MachineState>();
+        if (!options.loadStateFilename.empty()) {
+            auto data = readFile(options.loadStateFilename);
+            deserializeState(data, *state);
+            machine.loadState(*state);
+        }
+        std::optional<Movie> movie;
+        if (!options.replayFilename.empty()) {
+            auto data = readFile(options.replayFilename);
+            movie = deserializeMovie(data);
+            if (movie->romHash != hashRom(*rom)) {
+                throw std::runtime_error("Movie was recorded with a different ROM.");
+            }
+            deserializeState(movie->startState, *state);
+            machine.loadState(*state);
+        }
+        const uint64_t startFrame = machine.getFrameCount();
+        const uint64_t frames = options.frames.value_or(movie ? startFrame + movie->frames.size() : 60);
+        std::optional<Rewind> rewind;
+        if (options.rewindBudget > 0) {
+            rewind.emplace(options.rewindBudget);
+        }
+        std::string reason = "frames";
+        while (machine.getFrameCount() < frames) {
+            if (movie) {
+                auto frame = machine.getFrameCount() - startFrame;
+                machine.getMmu().setJoypad(frame < movie->frames.size() ? movie->frames[frame] : 0);
+            }
+            if (rewind) {
+                rewind->push(machine);
+            }
+            auto result = machine.runFrame(options.untilPc);
+            if (result == StepResult::Breakpoint) {
+                reason = "pc";
+                break;
+            }
+            if (result == StepResult::Stopped) {
+                reason = "stopped";
+                break;
+            }
+        }
+
+        if (!options.saveStateFilename.empty()) {
+            machine.saveState(*state);
+            auto data = serializeState(*state);
+            writeFile(options.saveStateFilename, data);
+        }
+        if (rewind) {
+            fmt::print("rewind frames={} bytes={}\n", rewind->size(), rewind->getMemoryUsage());
+        }
+        if (!machine.getMmu().getSerialOutput().empty()) {
+            fmt::print("serial:\n{}\n", machine.getMmu().getSerialOutput());
+        }
+        fmt::print("reason={} frames={} instructions={} state={:016x} frame={:016x}\n{}\n", reason, machine.getFrameCount(),
+            machine.getInstructionCount(), machine.getStateHash(), machine.getFrameHash(), machine.getCpu().toString());
+        return reason == "stopped" ? 2 : 0;
+    } catch (const std::exception& e) {
+        spdlog::error(e.what());
+        return 1;
+    }
+}
@@ -1,5 +1,7 @@
 #include "image.h"
 
+#include "pixeldecoder.h"
+
 Image::Image(unsigned int width, unsigned int height)
     : width(width)
     , height(height)
@@ -8,6 +10,7 @@ Image::Image(unsigned int width, unsigned int height)
 }
 
 static const std::vector<Color> palette = { { 255, 255, 255 }, { 170, 170, 170 }, { 85, 85, 85 }, { 0, 0, 0 } };
+static const PixelPalette pixelPalette = { toPixel(palette[0]), toPixel(palette[1]), toPixel(palette[2]), toPixel(palette[3]) };
 
 const uint8_t* Image::getData() const
 {
@@ -21,19 +24,33 @@ void Image::drawPixel(unsigned int x, unsigned int y, Color color)
     data[4 * (y * width + x) + 2] = color.b;
 }
 
-void Image::drawLine(uint8_t byte0, uint8_t byte1, unsigned int tileX, unsigned int tileY, uint8_t scx, uint8_t scy, uint8_t line)
+void Image::drawLine(const TileLine& colors, unsigned int tileX, unsigned int tileY, uint8_t scx, uint8_t scy, uint8_t line)
+{
+    auto x = static_cast<int>(tileX * pixelsPerLine) - scx;
+    auto y = static_cast<int>(tileY * linesPerTile + line) - scy;
+    if (y < 0 || y >= static_cast<int>(height)) {
+        return;
+    }
+    drawTileLine(colors, x, static_cast<unsigned int>(y));
+}
+
+void Image::drawTileLine(const TileLine& colors, int x, unsigned int y)
 {
-    for (auto pixel = pixelsPerLine - 1; pixel >= 0; --pixel) {
-        auto bit1 = (byte1 >> pixel) & 1;
-        auto bit0 = (byte0 >> pixel) & 1;
-        auto colorIndex = (bit0 << 1) + bit1;
-
-        auto color = palette.at(static_cast<uint8_t>(colorIndex));
-        auto x = static_cast<int>(tileX * pixelsPerLine + pixelsPerLine - 1 - static_cast<unsigned int>(pixel) - scx);
-        auto y = static_cast<int>(tileY * linesPerTile + line - scy);
-        if (y < 0 || y >= static_cast<int>(height) || x < 0 || x >= static_cast<int>(width)) {
+    if (x >= 0 && x + pixelsPerLine <= static_cast<int>(width)) {
+        resolveColors(colors.data(), colors.size(), pixelPalette, &data[bytesPerPixel * (y * width + static_cast<unsigned int>(x))]);
+        return;
+    }
+    // Tile is partially outside of image.
+    for (auto pixel = 0; pixel < pixelsPerLine; ++pixel) {
+        auto pixelX = x + pixel;
+        if (pixelX < 0 || pixelX >= static_cast<int>(width)) {
             continue;
         }
-        drawPixel(static_cast<unsigned int>(x), static_cast<unsigned int>(y), color);
+        drawPixel(static_cast<unsigned int>(pixelX), y, palette.at(colors[static_cast<size_t>(pixel)]));
     }
 }
+
+void Image::drawScanline(const uint8_t* colors, unsigned int y)
+{
+    resolveColors(colors, width, pixelPalette, &data[bytesPerPixel * y * width]);
+}
@@ -0,0 +1,182 @@
+#include "jit.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#ifdef GBEMU_HAS_JIT
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// Appends x86-64 machine code. Compiled code keeps the context in rbx, the executed instruction
+// count in r12d, the Cpu pointer in r13, the PC pointer in r14 and the operand pointer in r15,
+// so they survive handler calls without being saved.
+class Emitter {
+public:
+    std::vector<uint8_t> code;
+
+    void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+
+    template <typename T>
+    void emitValue(T value)
+    {
+        uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        code.insert(code.end(), bytes, bytes + sizeof(T));
+    }
+
+    // Conditional jump (0F 8x rel32) to the exit, bound by bindExit.
+    void jumpToExit(uint8_t condition)
+    {
+        emit({ 0x0F, condition });
+        exitJumps.push_back(code.size());
+        emitValue<int32_t>(0);
+    }
+
+    void bindExit()
+    {
+        for (auto jump : exitJumps) {
+            auto offset = static_cast<int32_t>(code.size() - (jump + sizeof(int32_t)));
+            std::memcpy(&code[jump], &offset, sizeof(offset));
+        }
+    }
+
+private:
+    std::vector<size_t> exitJumps;
+};
+
+constexpr uint8_t jae = 0x83;
+constexpr uint8_t jne = 0x85;
+
+// Context fields are addressed as [rbx + disp8].
+constexpr uint8_t field(size_t offset) { return static_cast<uint8_t>(offset); }
+
+} // namespace
+
+JitCompiler::~JitCompiler()
+{
+    clear();
+}
+
+void JitCompiler::clear()
+{
+#ifdef GBEMU_HAS_JIT
+    for (auto chunk : chunks) {
+        munmap(chunk, chunkSize);
+    }
+#endif
+    chunks.clear();
+    chunkUsed = chunkSize;
+}
+
+bool JitCompiler::isSupported()
+{
+#ifdef GBEMU_HAS_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+JitFunction JitCompiler::compile(gsl::span<const JitInstruction> instructions)
+{
+    if (!isSupported() || instructions.size() == 0) {
+        return nullptr;
+    }
+    static_assert(sizeof(JitContext) < 0x80, "Context fields must be reachable with 8 bit displacements");
+    Emitter e;
+
+    // Prologue: 5 pushes after the return address keep the stack 16 byte aligned for calls.
+    e.emit({ 0x53 }); // push rbx
+    e.emit({ 0x41, 0x54 }); // push r12
+    e.emit({ 0x41, 0x55 }); // push r13
+    e.emit({ 0x41, 0x56 }); // push r14
+    e.emit({ 0x41, 0x57 }); // push r15
+    e.emit({ 0x48, 0x89, 0xFB }); // mov rbx, rdi
+    e.emit({ 0x45, 0x31, 0xE4 }); // xor r12d, r12d
+    e.emit({ 0x4C, 0x8B, 0x6B, field(offsetof(JitContext, cpu)) }); // mov r13, [rbx + cpu]
+    e.emit({ 0x4C, 0x8B, 0x73, field(offsetof(JitContext, pc)) }); // mov r14, [rbx + pc]
+    e.emit({ 0x4C, 0x8B, 0x7B, field(offsetof(JitContext, operand)) }); // mov r15, [rbx + operand]
+
+    for (std::ptrdiff_t i = 0; i < instructions.size(); ++i) {
+        const auto& instruction = instructions[i];
+
+        e.emit({ 0x44, 0x3B, 0x63, field(offsetof(JitContext, limit)) }); // cmp r12d, [rbx + limit]
+        e.jumpToExit(jae);
+        // The caller checks the first instruction, later ones check the effects of the previous one.
+        if (i > 0) {
+            e.emit({ 0x66, 0x41, 0x81, 0x3E }); // cmp word [r14], address
+            e.emitValue<uint16_t>(instruction.address);
+            e.jumpToExit(jne);
+            e.emit({ 0x48, 0x8B, 0x43, field(offsetof(JitContext, codeEpoch)) }); // mov rax, [rbx + codeEpoch]
+            e.emit({ 0x8B, 0x00 }); // mov eax, [rax]
+            e.emit({ 0x3B, 0x43, field(offsetof(JitContext, entryEpoch)) }); // cmp eax, [rbx + entryEpoch]
+            e.jumpToExit(jne);
+            e.emit({ 0x48, 0x8B, 0x43, field(offsetof(JitContext, interruptFlag)) }); // mov rax, [rbx + interruptFlag]
+            e.emit({ 0x8A, 0x00 }); // mov al, [rax]
+            e.emit({ 0x48, 0x8B, 0x4B, field(offsetof(JitContext, interruptEnable)) }); // mov rcx, [rbx + interruptEnable]
+            e.emit({ 0x22, 0x01 }); // and al, [rcx]
+            e.emit({ 0x22, 0x43, field(offsetof(JitContext, interruptMask)) }); // and al, [rbx + interruptMask]
+            e.jumpToExit(jne);
+        }
+
+        e.emit({ 0x66, 0x41, 0xC7, 0x06 }); // mov word [r14], address + opcodeLength
+        e.emitValue<uint16_t>(static_cast<uint16_t>(instruction.address + instruction.opcodeLength));
+        e.emit({ 0x48, 0xB8 }); // mov rax, operands
+        e.emitValue(reinterpret_cast<uint64_t>(instruction.operands));
+        e.emit({ 0x49, 0x89, 0x07 }); // mov [r15], rax
+        e.emit({ 0x4C, 0x89, 0xEF }); // mov rdi, r13
+        e.emit({ 0x48, 0xB8 }); // mov rax, execute
+        e.emitValue(reinterpret_cast<uint64_t>(instruction.execute));
+        e.emit({ 0xFF, 0xD0 }); // call rax
+        e.emit({ 0x41, 0xFF, 0xC4 }); // inc r12d
+    }
+
+    e.bindExit();
+    e.emit({ 0x44, 0x89, 0xE0 }); // mov eax, r12d
+    e.emit({ 0x41, 0x5F }); // pop r15
+    e.emit({ 0x41, 0x5E }); // pop r14
+    e.emit({ 0x41, 0x5D }); // pop r13
+    e.emit({ 0x41, 0x5C }); // pop r12
+    e.emit({ 0x5B }); // pop rbx
+    e.emit({ 0xC3 }); // ret
+
+    auto code = install(e.code);
+    return code ? reinterpret_cast<JitFunction>(code) : nullptr;
+}
+
+const uint8_t* JitCompiler::install(const std::vector<uint8_t>& code)
+{
+#ifdef GBEMU_HAS_JIT
+    if (code.size() > chunkSize) {
+        return nullptr;
+    }
+    if (chunkUsed + code.size() > chunkSize) {
+        if (chunks.size() == maxChunks) {
+            return nullptr;
+        }
+        void* chunk = mmap(nullptr, chunkSize, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (chunk == MAP_FAILED) {
+            return nullptr;
+        }
+        chunks.push_back(static_cast<uint8_t*>(chunk));
+        chunkUsed = 0;
+    }
+    uint8_t* chunk = chunks.back();
+    if (mprotect(chunk, chunkSize, PROT_READ | PROT_WRITE) != 0) {
+        return nullptr;
+    }
+    std::memcpy(chunk + chunkUsed, code.data(), code.size());
+    if (mprotect(chunk, chunkSize, PROT_READ | PROT_EXEC) != 0) {
+        return nullptr;
+    }
+    const uint8_t* installed = chunk + chunkUsed;
+    // Keep code 16 byte aligned.
+    chunkUsed = (chunkUsed + code.size() + 15) & ~size_t{ 15 };
+    return installed;
+#else
+    (void)code;
+    return nullptr;
+#endif
+}
@@ -0,0 +1,126 @@
+#include "machine.h"
+
+#include "utils.h"
+
+#include <array>
+#include <cstddef>
+
+Machine::Machine(const std::vector<uint8_t>& bootstrap, std::shared_ptr<const Rom> rom)
+    : mmu()
+    , timer()
+    , scheduler()
+    , cpu(mmu, timer)
+    , gpu(mmu, scheduler)
+{
+    mmu.loadBootstrap(bootstrap);
+    mmu.loadCartridge(std::move(rom));
+}
+
+StepResult Machine::step()
+{
+    if (!cpu.execute()) {
+        return StepResult::Stopped;
+    }
+    ++instructionCount;
+    if (timer.getCycles() >= scheduler.getNextDeadline() && handleEvents()) {
+        ++frameCount;
+        return StepResult::FrameFinished;
+    }
+    return StepResult::Executed;
+}
+
+StepResult Machine::runFrame(std::optional<uint16_t> breakpoint)
+{
+    while (true) {
+        // Nothing but the CPU needs attention until the next deadline.
+        auto now = timer.getCycles();
+        auto deadline = scheduler.getNextDeadline();
+        if (now < deadline) {
+            auto result = cpu.run(deadline - now, breakpoint);
+            instructionCount += result.instructions;
+            switch (result.reason) {
+            case StopReason::Budget:
+                break;
+            case StopReason::Breakpoint:
+                return StepResult::Breakpoint;
+            case StopReason::UnimplementedOpcode:
+                return StepResult::Stopped;
+            }
+        }
+        if (handleEvents()) {
+            ++frameCount;
+            return StepResult::FrameFinished;
+        }
+    }
+}
+
+bool Machine::handleEvents()
+{
+    bool isFrameFinished = false;
+    while (auto event = scheduler.popDue(timer.getCycles())) {
+        switch (*event) {
+        case Event::GpuModeEnd:
+            isFrameFinished |= gpu.endMode();
+            break;
+        }
+    }
+    return isFrameFinished;
+}
+
+void Machine::saveState(MachineState& state, bool withMemory) const
+{
+    cpu.saveState(state.cpu);
+    mmu.saveState(state.mmu, withMemory);
+    gpu.saveState(state.gpu, withMemory);
+    scheduler.saveState(state.scheduler);
+    state.cycles = timer.getCycles();
+    state.frameCount = frameCount;
+    state.instructionCount = instructionCount;
+}
+
+void Machine::loadState(const MachineState& state)
+{
+    mmu.loadState(state.mmu);
+    cpu.loadState(state.cpu);
+    gpu.loadState(state.gpu);
+    scheduler.loadState(state.scheduler);
+    timer.setCycles(state.cycles);
+    frameCount = state.frameCount;
+    instructionCount = state.instructionCount;
+}
+
+std::array<Machine::StateMemory, 3> Machine::getStateMemory() const
+{
+    return { {
+        { offsetof(MachineState, mmu.memory), sizeof(Mmu::State::memory), mmu.getMemory() },
+        { offsetof(MachineState, mmu.cartridge.ram), sizeof(Cartridge::State::ram), mmu.getCartridgeRam() },
+        { offsetof(MachineState, gpu.colorIndices), sizeof(Gpu::State::colorIndices), gpu.getColorIndices() },
+    } };
+}
+
+uint64_t Machine::getStateHash() const
+{
+    // Little endian regardless of host, so hashes can be compared across machines.
+    std::array<uint8_t, 12> registers;
+    auto i = 0u;
+    for (auto reg : { cpu.getAF(), cpu.getBC(), cpu.getDE(), cpu.getHL(), cpu.getSP(), cpu.getPC() }) {
+        registers[i++] = static_cast<uint8_t>(reg);
+        registers[i++] = static_cast<uint8_t>(reg >> 8);
+    }
+    uint64_t hash = hashBytes(registers);
+
+    std::array<uint8_t, 0x100> page;
+    for (auto address = 0u; address <= 0xFFFF; address += page.size()) {
+        for (auto offset = 0u; offset < page.size(); ++offset) {
+            page[offset] = mmu.get(static_cast<uint16_t>(address + offset));
+        }
+        hash = hashBytes(page, hash);
+    }
+    return hash;
+}
+
+uint64_t Machine::getFrameHash() const
+{
+    const Image& frame = gpu.getScreenBuffer();
+    return xxHash64(gsl::make_span(frame.getData(), frame.getSize()));
+}
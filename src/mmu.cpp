@@ -1,61 +1,210 @@
 #include "mmu.h"
 
 #include <algorithm>
+#include <stdexcept>
 #include <vector>
 
 #include <spdlog/spdlog.h>
 
+// Contents of unmapped memory, such as disabled external RAM.
+static const std::vector<uint8_t> openBus(0x100, 0xFF);
+
 Mmu::Mmu()
-    : memory(0x10000, 0)
+    : memory(0x10000 - romSize, 0)
+{
+    mapPages();
+    updateJoypad(0x00);
+}
+
+void Mmu::mapPages()
 {
+    for (auto page = romSize / pageSize; page < pageCount; ++page) {
+        auto address = page * pageSize;
+        // Echo RAM at 0xE000-0xFDFF mirrors work RAM at 0xC000-0xDDFF.
+        if (address >= 0xE000 && address < 0xFE00) {
+            address -= 0x2000;
+        }
+        readPages[page] = &memory[address - romSize];
+        writePages[page] = &memory[address - romSize];
+    }
+    // Tile data, writes invalidate decoded tiles.
+    for (auto page = 0x80u; page < 0x98u; ++page) {
+        writePages[page] = nullptr;
+    }
+    // I/O registers, high RAM and interrupt enable register.
+    writePages[0xFF] = nullptr;
+
+    mapCartridge();
 }
 
-void Mmu::set(uint16_t address, uint8_t value)
+void Mmu::mapCartridge()
 {
+    static constexpr auto bankPages = Cartridge::romBankSize / pageSize;
+    for (auto page = 0u; page < bankPages; ++page) {
+        readPages[page] = cartridge.getRomBank0() + page * pageSize;
+        readPages[bankPages + page] = cartridge.getRomBank() + page * pageSize;
+        writePages[page] = nullptr;
+        writePages[bankPages + page] = nullptr;
+    }
+    if (isBootstrapMapped) {
+        readPages[0] = bootstrap.data();
+    }
+
+    uint8_t* ram = cartridge.getRamBank();
+    for (auto page = 0u; page < Cartridge::ramBankSize / pageSize; ++page) {
+        readPages[0xA0 + page] = ram ? ram + page * pageSize : openBus.data();
+        writePages[0xA0 + page] = ram ? ram + page * pageSize : nullptr;
+    }
+    ++codeEpoch;
+}
+
+void Mmu::setJoypad(uint8_t buttons)
+{
+    joypad = buttons;
+    updateJoypad(get(0xFF00));
+}
+
+void Mmu::updateJoypad(uint8_t select)
+{
+    // Lines are active low, bit 4 selects directions and bit 5 the other buttons.
+    uint8_t pressed = 0;
+    if (!(select & 0x10)) {
+        pressed |= joypad & 0x0F;
+    }
+    if (!(select & 0x20)) {
+        pressed |= joypad >> 4;
+    }
+    uint8_t value = static_cast<uint8_t>(0xC0 | (select & 0x30) | (~pressed & 0x0F));
+    uint8_t& reg = memory[0xFF00 - romSize];
+    if (reg & ~value & 0x0F) {
+        memory[0xFF0F - romSize] |= 0x10;
+    }
+    reg = value;
+}
+
+void Mmu::watchCode(uint16_t address)
+{
+    auto page = address >> 8;
+    if (page < 0xC0 || page >= 0xE0) {
+        return;
+    }
+    writePages[page] = nullptr;
+    // Echo RAM at 0xE000-0xFDFF mirrors work RAM at 0xC000-0xDDFF.
+    if (page < 0xDE) {
+        writePages[page + 0x20] = nullptr;
+    }
+}
+
+void Mmu::setIo(uint16_t address, uint8_t value)
+{
+    if (address < romSize) {
+        cartridge.write(address, value);
+        mapCartridge();
+        return;
+    }
+    if (address < 0x9800) {
+        memory[address - romSize] = value;
+        tiles.invalidate((address - 0x8000u) / TileCache::bytesPerTile);
+        return;
+    }
+    if (address >= 0xA000 && address < 0xC000) {
+        return; // External RAM is disabled
+    }
+    if (address >= 0xC000 && address < 0xFE00) {
+        // Watched work RAM or its echo, stop watching it after letting the CPU know code changed.
+        uint16_t ramAddress = address < 0xE000 ? address : address - 0x2000;
+        auto page = ramAddress >> 8;
+        writePages[page] = &memory[(page << 8) - romSize];
+        if (page < 0xDE) {
+            writePages[page + 0x20] = writePages[page];
+        }
+        ++codeVersions[page];
+        ++codeEpoch;
+        memory[ramAddress - romSize] = value;
+        return;
+    }
+    if (address == 0xFF00) {
+        updateJoypad(value);
+        return;
+    }
     // Writing 0x81 to 0xFF02 transfers value from 0xFF01 over serial link.
-    // Emulate this by logging it.
+    // Emulate this by capturing it, test ROMs report their results this way.
     if (address == 0xFF02 && value == 0x81) {
-        spdlog::info("{:02x}", get(0xFF01));
+        serialOutput.push_back(static_cast<char>(get(0xFF01)));
+        spdlog::debug("Serial: {:02x}", get(0xFF01));
     }
     // Writing the value of 1 to the address 0xFF50 unmaps the boot ROM.
     if (address == 0xFF50 && value == 0x01) {
         spdlog::info("Unmapping boot ROM.");
-        loadBootstrap(cartridgeStart);
+        isBootstrapMapped = false;
+        readPages[0] = cartridge.getRomBank0();
+        ++codeEpoch;
     }
-    memory.at(address) = value;
+    memory[address - romSize] = value;
 }
 
-uint8_t Mmu::get(uint16_t address) const
+void Mmu::loadBootstrap(const std::vector<uint8_t>& rom)
 {
-    return memory.at(address);
+    if (rom.size() != pageSize) {
+        throw std::runtime_error(fmt::format("Bootstrap ROM size must be 0x{:x}, given size: 0x{:x}", pageSize, rom.size()));
+    }
+    bootstrap = rom;
+    isBootstrapMapped = true;
+    readPages[0] = bootstrap.data();
+    ++codeEpoch;
 }
 
-void Mmu::loadBootstrap(const std::vector<uint8_t>& rom)
+void Mmu::loadCartridge(std::shared_ptr<const Rom> rom)
 {
-    memory.erase(memory.begin(), memory.begin() + 0x100);
-    memory.insert(memory.begin(), rom.begin(), rom.end());
+    cartridge = Cartridge{ std::move(rom) };
+    mapCartridge();
 }
 
-void Mmu::loadCartridge(const std::vector<uint8_t>& rom)
+void Mmu::loadCartridge(std::vector<uint8_t> rom)
 {
-    auto const allowedSize = 0x8000;
-    if (rom.size() > allowedSize) {
-        spdlog::warn("Cartridge size not supported. Supported size: 0x{:x}, given size: 0x{:x}", allowedSize, rom.size());
-    }
-    // Don't overwrite the boot ROM.
-    cartridgeStart = std::vector<uint8_t>{ rom.begin(), rom.begin() + 0x100 };
-    auto size = static_cast<int>(rom.size());
-    memory.erase(memory.begin() + 0x100, memory.begin() + size);
-    memory.insert(memory.begin() + 0x100, rom.begin() + 0x100, rom.end());
+    loadCartridge(std::make_shared<const Rom>(std::move(rom)));
 }
 
 const gsl::span<const uint8_t> Mmu::getVram() const
 {
     // VRAM is between 0x8000 and 0xA000
-    return gsl::make_span(memory).subspan(0x8000, 0x2000);
+    return gsl::make_span(memory).subspan(0x8000 - romSize, 0x2000);
+}
+
+const Tile& Mmu::getTile(unsigned int index) const
+{
+    return tiles.get(getVram(), index);
+}
+
+void Mmu::saveState(State& state, bool withMemory) const
+{
+    if (withMemory) {
+        std::copy(memory.begin(), memory.end(), state.memory.begin());
+    }
+    state.isBootstrapMapped = isBootstrapMapped;
+    state.joypad = joypad;
+    cartridge.saveState(state.cartridge, withMemory);
+}
+
+void Mmu::loadState(const State& state)
+{
+    if (state.isBootstrapMapped && bootstrap.empty()) {
+        throw std::runtime_error("State has bootstrap ROM mapped, but none is loaded");
+    }
+    cartridge.loadState(state.cartridge);
+    std::copy(state.memory.begin(), state.memory.end(), memory.begin());
+    isBootstrapMapped = state.isBootstrapMapped;
+    joypad = state.joypad;
+    tiles.invalidateAll();
+    // Only work RAM code can differ from the saved state. ROM can't change, and bank switches and
+    // the bootstrap ROM are caught by the CPU comparing pages.
+    for (auto page = 0xC0u; page < 0xE0; ++page) {
+        ++codeVersions[page];
+    }
+    mapPages();
 }
 
-std::vector<uint8_t> Mmu::getMemory() const
+uint8_t Mmu::read(uint16_t address) const
 {
-    return memory;
+    return get(address);
 }
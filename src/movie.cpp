@@ -0,0 +1,97 @@
+#include "movie.h"
+
+#include "savestate.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+#include "fmt/format.h"
+
+static const std::array<uint8_t, 4> magic = { 'G', 'B', 'M', 'V' };
+
+static void writeLittleEndian(std::vector<uint8_t>& out, uint64_t value, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static uint64_t readLittleEndian(gsl::span<const uint8_t> data, std::ptrdiff_t& position, int size)
+{
+    if (size > data.size() - position) {
+        throw std::runtime_error("Movie is truncated");
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i) {
+        value |= static_cast<uint64_t>(data[position++]) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t hashRom(const Rom& rom)
+{
+    return hashBytes(gsl::make_span(rom.data(), static_cast<std::ptrdiff_t>(rom.size())));
+}
+
+std::vector<uint8_t> serializeMovie(const Movie& movie)
+{
+    std::vector<uint8_t> data(magic.begin(), magic.end());
+    writeLittleEndian(data, movieVersion, 4);
+    writeLittleEndian(data, movie.romHash, 8);
+    writeLittleEndian(data, movie.startState.size(), 4);
+    writeLittleEndian(data, movie.frames.size(), 4);
+    data.insert(data.end(), movie.startState.begin(), movie.startState.end());
+    data.insert(data.end(), movie.frames.begin(), movie.frames.end());
+    return data;
+}
+
+Movie deserializeMovie(gsl::span<const uint8_t> data)
+{
+    std::ptrdiff_t position = 0;
+    for (auto byte : magic) {
+        if (readLittleEndian(data, position, 1) != byte) {
+            throw std::runtime_error("Not a movie");
+        }
+    }
+    auto version = readLittleEndian(data, position, 4);
+    if (version != movieVersion) {
+        throw std::runtime_error(fmt::format("Movie version {} is not supported, expected {}", version, movieVersion));
+    }
+    Movie movie;
+    movie.romHash = readLittleEndian(data, position, 8);
+    auto stateSize = static_cast<std::ptrdiff_t>(readLittleEndian(data, position, 4));
+    auto frameCount = static_cast<std::ptrdiff_t>(readLittleEndian(data, position, 4));
+    if (data.size() - position != stateSize + frameCount) {
+        throw std::runtime_error("Movie size doesn't match its header");
+    }
+    auto state = data.subspan(position, stateSize);
+    auto frames = data.subspan(position + stateSize, frameCount);
+    movie.startState.assign(state.begin(), state.end());
+    movie.frames.assign(frames.begin(), frames.end());
+    return movie;
+}
+
+MovieRecorder::MovieRecorder(const Machine& machine, const Rom& rom)
+    : startFrame(machine.getFrameCount())
+{
+    movie.romHash = hashRom(rom);
+    auto state = std::make_unique<MachineState>();
+    machine.saveState(*state);
+    movie.startState = serializeState(*state);
+}
+
+void MovieRecorder::record(const Machine& machine)
+{
+    movie.frames.resize(machine.getFrameCount() - startFrame);
+    movie.frames.push_back(machine.getMmu().getJoypad());
+}
+
+Movie MovieRecorder::getMovie(const Machine& machine) const
+{
+    Movie finished = movie;
+    finished.frames.resize(std::min<size_t>(finished.frames.size(), machine.getFrameCount() - startFrame));
+    return finished;
+}
@@ -0,0 +1,79 @@
+// Build step: convert lib/opcodes/opcodes.json into constexpr OpcodeData tables compiled into utils.
+
+#include <array>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+static std::string quote(const json& opcode, const std::string& key)
+{
+    if (!opcode.contains(key)) {
+        return "nullptr";
+    }
+    std::string value = opcode.at(key);
+    std::string quoted = "\"";
+    for (auto c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void writeTable(std::ostream& out, const json& opcodes, const std::string& name)
+{
+    std::array<std::optional<json>, 256> table;
+    for (auto& [key, opcode] : opcodes.items()) {
+        table.at(std::stoul(key, nullptr, 16)) = opcode;
+    }
+
+    out << "constexpr std::array<OpcodeData, 256> " << name << " = { {\n";
+    for (auto i = 0u; i < table.size(); ++i) {
+        char index[8];
+        std::snprintf(index, sizeof(index), "0x%02X", i);
+        if (!table[i]) {
+            out << "    {}, // " << index << "\n";
+            continue;
+        }
+        const json& opcode = *table[i];
+        out << "    { " << quote(opcode, "mnemonic") << ", " << opcode.at("length").get<int>() << ", "
+            << quote(opcode, "operand1") << ", " << quote(opcode, "operand2") << " }, // " << index << "\n";
+    }
+    out << "} };\n\n";
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        if (argc < 3) {
+            throw std::runtime_error("Usage: opcodegen opcodes.json output");
+        }
+        std::ifstream input(argv[1]);
+        if (input.fail()) {
+            throw std::runtime_error(std::string("Couldn't open file: ") + argv[1]);
+        }
+        json opcodes;
+        input >> opcodes;
+
+        std::ofstream out(argv[2]);
+        if (out.fail()) {
+            throw std::runtime_error(std::string("Couldn't open file: ") + argv[2]);
+        }
+        out << "// Generated by opcodegen from opcodes.json, do not edit.\n\n";
+        writeTable(out, opcodes.at("unprefixed"), "unprefixedOpcodes");
+        writeTable(out, opcodes.at("cbprefixed"), "cbprefixedOpcodes");
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
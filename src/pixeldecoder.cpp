@@ -0,0 +1,169 @@
+#include "pixeldecoder.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GBEMU_HAS_SSE2
+// AVX2 code is compiled with a target attribute and only called when the host CPU supports it.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GBEMU_HAS_AVX2
+#endif
+#endif
+
+Pixel toPixel(Color color)
+{
+    uint8_t bytes[sizeof(Pixel)] = { color.r, color.g, color.b, 0 };
+    Pixel pixel;
+    std::memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+static void decodeRowsScalar(const uint8_t* data, size_t rows, uint8_t* colorIndices)
+{
+    for (size_t row = 0; row < rows; ++row) {
+        auto low = data[2 * row];
+        auto high = data[2 * row + 1];
+        for (auto pixel = 0; pixel < pixelsPerLine; ++pixel) {
+            auto bit = pixelsPerLine - 1 - pixel;
+            *colorIndices++ = static_cast<uint8_t>((((high >> bit) & 1) << 1) | ((low >> bit) & 1));
+        }
+    }
+}
+
+static void resolveColorsScalar(const uint8_t* colorIndices, size_t count, const PixelPalette& palette, uint8_t* pixels)
+{
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(pixels + i * sizeof(Pixel), &palette[colorIndices[i] & 3], sizeof(Pixel));
+    }
+}
+
+#ifdef GBEMU_HAS_SSE2
+// Two rows per vector, each bit plane byte is broadcast to 8 lanes and tested against the bit of its pixel.
+static void decodeRowsSse2(const uint8_t* data, size_t rows, uint8_t* colorIndices)
+{
+    const __m128i masks = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i twos = _mm_set1_epi8(2);
+    size_t row = 0;
+    for (; row + 2 <= rows; row += 2, data += 4, colorIndices += 16) {
+        __m128i low = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(data[0])), _mm_set1_epi8(static_cast<char>(data[2])));
+        __m128i high = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(data[1])), _mm_set1_epi8(static_cast<char>(data[3])));
+        __m128i lowBits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, masks), masks), ones);
+        __m128i highBits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, masks), masks), twos);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(colorIndices), _mm_or_si128(lowBits, highBits));
+    }
+    decodeRowsScalar(data, rows - row, colorIndices);
+}
+
+// Four pixels per vector, SSE2 has no variable shuffle so each palette entry is selected by comparison.
+static void resolveColorsSse2(const uint8_t* colorIndices, size_t count, const PixelPalette& palette, uint8_t* pixels)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i three = _mm_set1_epi32(3);
+    __m128i entries[4];
+    for (auto i = 0u; i < palette.size(); ++i) {
+        entries[i] = _mm_set1_epi32(static_cast<int>(palette[i]));
+    }
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int packed;
+        std::memcpy(&packed, colorIndices + i, sizeof(packed));
+        __m128i indices = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        indices = _mm_and_si128(indices, three);
+        __m128i result = zero;
+        for (auto entry = 0; entry < 4; ++entry) {
+            __m128i isEntry = _mm_cmpeq_epi32(indices, _mm_set1_epi32(entry));
+            result = _mm_or_si128(result, _mm_and_si128(isEntry, entries[entry]));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i * sizeof(Pixel)), result);
+    }
+    resolveColorsScalar(colorIndices + i, count - i, palette, pixels + i * sizeof(Pixel));
+}
+#endif
+
+#ifdef GBEMU_HAS_AVX2
+// Four rows per vector.
+__attribute__((target("avx2"))) static void decodeRowsAvx2(const uint8_t* data, size_t rows, uint8_t* colorIndices)
+{
+    const __m256i masks = _mm256_set1_epi64x(0x0102040810204080);
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i twos = _mm256_set1_epi8(2);
+    // Shuffle indices broadcasting the first (low) or second (high) byte of each 64 bit lane to the
+    // whole lane, shuffles index bytes within 128 bit halves.
+    const __m256i lowBytes = _mm256_setr_epi64x(0, 0x0808080808080808, 0, 0x0808080808080808);
+    const __m256i highBytes = _mm256_setr_epi64x(0x0101010101010101, 0x0909090909090909, 0x0101010101010101, 0x0909090909090909);
+    size_t row = 0;
+    for (; row + 4 <= rows; row += 4, data += 8, colorIndices += 32) {
+        uint64_t planes;
+        std::memcpy(&planes, data, sizeof(planes));
+        // Lane n holds (low, high) of row n in its first two bytes.
+        __m256i rowPlanes = _mm256_setr_epi64x(static_cast<long long>(planes & 0xFFFF), static_cast<long long>((planes >> 16) & 0xFFFF),
+            static_cast<long long>((planes >> 32) & 0xFFFF), static_cast<long long>(planes >> 48));
+        __m256i low = _mm256_shuffle_epi8(rowPlanes, lowBytes);
+        __m256i high = _mm256_shuffle_epi8(rowPlanes, highBytes);
+        __m256i lowBits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(low, masks), masks), ones);
+        __m256i highBits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(high, masks), masks), twos);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(colorIndices), _mm256_or_si256(lowBits, highBits));
+    }
+    decodeRowsSse2(data, rows - row, colorIndices);
+}
+
+// Eight pixels per vector, the palette fits into one register and is indexed with a permute.
+__attribute__((target("avx2"))) static void resolveColorsAvx2(const uint8_t* colorIndices, size_t count, const PixelPalette& palette, uint8_t* pixels)
+{
+    const __m256i three = _mm256_set1_epi32(3);
+    __m128i entries = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette.data()));
+    __m256i table = _mm256_broadcastsi128_si256(entries);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(colorIndices + i)));
+        __m256i result = _mm256_permutevar8x32_epi32(table, _mm256_and_si256(indices, three));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i * sizeof(Pixel)), result);
+    }
+    resolveColorsScalar(colorIndices + i, count - i, palette, pixels + i * sizeof(Pixel));
+}
+#endif
+
+static const PixelKernels scalarKernels{ SimdLevel::Scalar, "scalar", decodeRowsScalar, resolveColorsScalar };
+#ifdef GBEMU_HAS_SSE2
+static const PixelKernels sse2Kernels{ SimdLevel::Sse2, "sse2", decodeRowsSse2, resolveColorsSse2 };
+#endif
+#ifdef GBEMU_HAS_AVX2
+static const PixelKernels avx2Kernels{ SimdLevel::Avx2, "avx2", decodeRowsAvx2, resolveColorsAvx2 };
+#endif
+
+const PixelKernels* getPixelKernels(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Scalar:
+        return &scalarKernels;
+    case SimdLevel::Sse2:
+#ifdef GBEMU_HAS_SSE2
+        return &sse2Kernels;
+#else
+        return nullptr;
+#endif
+    case SimdLevel::Avx2:
+#ifdef GBEMU_HAS_AVX2
+        return __builtin_cpu_supports("avx2") ? &avx2Kernels : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+const PixelKernels& getPixelKernels()
+{
+    static const PixelKernels& best = []() -> const PixelKernels& {
+        for (auto level : { SimdLevel::Avx2, SimdLevel::Sse2 }) {
+            if (auto kernels = getPixelKernels(level)) {
+                return *kernels;
+            }
+        }
+        return scalarKernels;
+    }();
+    return best;
+}
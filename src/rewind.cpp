@@ -0,0 +1,259 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+static constexpr size_t wordSize = sizeof(uint64_t);
+
+static uint8_t* getBytes(MachineState& state)
+{
+    return reinterpret_cast<uint8_t*>(&state);
+}
+
+static size_t wordsIn(size_t bytes)
+{
+    return (bytes + wordSize - 1) / wordSize;
+}
+
+static uint64_t loadWord(const uint8_t* bytes, size_t word)
+{
+    uint64_t value;
+    std::memcpy(&value, bytes + word * wordSize, wordSize);
+    return value;
+}
+
+static void writeVarint(std::vector<uint8_t>& out, size_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t readVarint(const uint8_t*& in)
+{
+    size_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        auto byte = *in++;
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+// Runs of words in an encoded delta, stored in the low bits of the varint holding their length.
+enum class Run : uint8_t {
+    Unchanged, // Words equal to the base
+    Repeated, // One XOR value applied to all words, follows the length
+    Literal // XOR values of each word follow the length
+};
+
+// Repeated words are only worth a run of their own if there are a few of them.
+static const size_t minRepeatedRun = 3;
+
+static void writeRun(std::vector<uint8_t>& out, Run run, size_t length)
+{
+    writeVarint(out, length << 2 | static_cast<size_t>(run));
+}
+
+static void writeWord(std::vector<uint8_t>& out, uint64_t value)
+{
+    uint8_t bytes[wordSize];
+    std::memcpy(bytes, &value, wordSize);
+    out.insert(out.end(), bytes, bytes + wordSize);
+}
+
+// Encode XOR of current with base (zeros if nullptr) as runs covering all words of current, the
+// last one padded with zeros. Base holds whole words.
+static void encodeDelta(gsl::span<const uint8_t> current, const uint8_t* base, std::vector<uint8_t>& out)
+{
+    static const uint8_t zeros[4096] = {};
+    const size_t words = wordsIn(current.size());
+    const size_t wholeWords = current.size() / wordSize;
+    auto load = [&](size_t word) {
+        if (word < wholeWords) {
+            return loadWord(current.data(), word);
+        }
+        uint64_t value = 0;
+        std::memcpy(&value, current.data() + word * wordSize, current.size() - word * wordSize);
+        return value;
+    };
+    auto difference = [&](size_t word) { return load(word) ^ (base ? loadWord(base, word) : 0); };
+    // Find the first changed word from word on. Most of the memory is compared in large blocks,
+    // then in small ones, as each comparison has a fixed cost.
+    auto findChange = [&](size_t word) {
+        for (size_t blockWords : { sizeof(zeros) / wordSize, size_t{ 8 } }) {
+            auto isBlockUnchanged = [&] {
+                return std::memcmp(current.data() + word * wordSize, base ? base + word * wordSize : zeros, blockWords * wordSize) == 0;
+            };
+            while (word + blockWords <= wholeWords && isBlockUnchanged()) {
+                word += blockWords;
+            }
+        }
+        while (word < words && difference(word) == 0) {
+            ++word;
+        }
+        return word;
+    };
+    auto writeLiterals = [&](size_t begin, size_t end) {
+        if (end > begin) {
+            writeRun(out, Run::Literal, end - begin);
+            for (auto word = begin; word < end; ++word) {
+                writeWord(out, difference(word));
+            }
+        }
+    };
+
+    size_t literalStart = 0;
+    for (size_t word = 0; word < words;) {
+        uint64_t value = difference(word);
+        size_t runEnd = word + 1;
+        if (value == 0) {
+            runEnd = findChange(word);
+        } else {
+            while (runEnd < words && difference(runEnd) == value) {
+                ++runEnd;
+            }
+        }
+        if (value == 0 || runEnd - word >= minRepeatedRun) {
+            writeLiterals(literalStart, word);
+            writeRun(out, value == 0 ? Run::Unchanged : Run::Repeated, runEnd - word);
+            if (value != 0) {
+                writeWord(out, value);
+            }
+            literalStart = runEnd;
+        }
+        word = runEnd;
+    }
+    writeLiterals(literalStart, words);
+}
+
+// XOR delta encoded by encodeDelta into target.
+static void applyDelta(const std::vector<uint8_t>& delta, uint8_t* target)
+{
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+    size_t word = 0;
+    while (in != end) {
+        auto header = readVarint(in);
+        auto run = static_cast<Run>(header & 3);
+        auto length = header >> 2;
+        if (run == Run::Unchanged) {
+            word += length;
+            continue;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < length; ++i, ++word) {
+            if (run == Run::Literal || i == 0) {
+                std::memcpy(&value, in, wordSize);
+                in += wordSize;
+            }
+            uint64_t result = value ^ loadWord(target, word);
+            std::memcpy(target + word * wordSize, &result, wordSize);
+        }
+    }
+}
+
+Rewind::Rewind(size_t memoryBudget, unsigned keyframeInterval)
+    : memoryBudget(memoryBudget)
+    , keyframeInterval(std::max(keyframeInterval, 1u))
+    , state(std::make_unique<MachineState>())
+{
+}
+
+size_t Rewind::splitState(const Machine& machine)
+{
+    const uint8_t* bytes = getBytes(*state);
+    parts.clear();
+    size_t offset = 0;
+    size_t words = 0;
+    auto add = [&](size_t partOffset, gsl::span<const uint8_t> data) {
+        parts.push_back({ partOffset, data });
+        words += wordsIn(data.size());
+    };
+    for (const auto& memory : machine.getStateMemory()) {
+        add(offset, gsl::make_span(bytes + offset, memory.offset - offset));
+        add(memory.offset, memory.data);
+        offset = memory.offset + memory.size;
+    }
+    add(offset, gsl::make_span(bytes + offset, sizeof(MachineState) - offset));
+    return words * wordSize;
+}
+
+void Rewind::push(const Machine& machine)
+{
+    machine.saveState(*state, false);
+    size_t size = splitState(machine);
+    unsigned position = frames.empty() ? 0 : (frames.back().groupPosition + 1) % keyframeInterval;
+    if (size != keyframe.size()) {
+        position = 0;
+    }
+
+    encoded.clear();
+    size_t offset = 0;
+    for (const auto& part : parts) {
+        encodeDelta(part.data, position == 0 ? nullptr : keyframe.data() + offset, encoded);
+        offset += wordsIn(part.data.size()) * wordSize;
+    }
+    if (position == 0) {
+        keyframe.assign(size, 0);
+        applyDelta(encoded, keyframe.data());
+    }
+    frames.push_back({ encoded, position });
+    memoryUsage += encoded.size();
+
+    // Drop the oldest groups, but keep the newest one even if it doesn't fit.
+    while (memoryUsage > memoryBudget) {
+        auto nextGroup = std::find_if(frames.begin() + 1, frames.end(), [](const Frame& frame) { return frame.groupPosition == 0; });
+        if (nextGroup == frames.end()) {
+            break;
+        }
+        for (auto frame = frames.begin(); frame != nextGroup; ++frame) {
+            memoryUsage -= frame->delta.size();
+        }
+        frames.erase(frames.begin(), nextGroup);
+    }
+}
+
+bool Rewind::rewind(Machine& machine)
+{
+    if (frames.empty()) {
+        return false;
+    }
+    const Frame& frame = frames.back();
+    snapshot = keyframe;
+    if (frame.groupPosition != 0) {
+        applyDelta(frame.delta, snapshot.data());
+    }
+    memoryUsage -= frame.delta.size();
+    bool isKeyframe = frame.groupPosition == 0;
+    frames.pop_back();
+    if (isKeyframe && !frames.empty()) {
+        decodeKeyframe();
+    }
+
+    splitState(machine);
+    size_t offset = 0;
+    for (const auto& part : parts) {
+        std::memcpy(getBytes(*state) + part.offset, snapshot.data() + offset, part.data.size());
+        offset += wordsIn(part.data.size()) * wordSize;
+    }
+    machine.loadState(*state);
+    return true;
+}
+
+void Rewind::clear()
+{
+    frames.clear();
+    memoryUsage = 0;
+}
+
+void Rewind::decodeKeyframe()
+{
+    const Frame& frame = frames[frames.size() - 1 - frames.back().groupPosition];
+    std::fill(keyframe.begin(), keyframe.end(), 0);
+    applyDelta(frame.delta, keyframe.data());
+}
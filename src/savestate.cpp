@@ -0,0 +1,237 @@
+#include "savestate.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "fmt/format.h"
+
+static const std::array<uint8_t, 4> magic = { 'G', 'B', 'S', 'S' };
+
+namespace {
+
+class StateWriter {
+public:
+    std::vector<uint8_t> data;
+
+    void write(uint8_t value) { data.push_back(value); }
+
+    void write(uint16_t value) { writeLittleEndian(value, 2); }
+
+    void write(uint32_t value) { writeLittleEndian(value, 4); }
+
+    void write(uint64_t value) { writeLittleEndian(value, 8); }
+
+    void write(gsl::span<const uint8_t> bytes) { data.insert(data.end(), bytes.begin(), bytes.end()); }
+
+private:
+    void writeLittleEndian(uint64_t value, int size)
+    {
+        for (int i = 0; i < size; ++i) {
+            data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+};
+
+class StateReader {
+public:
+    explicit StateReader(gsl::span<const uint8_t> data)
+        : data(data)
+    {
+    }
+
+    uint8_t read8() { return static_cast<uint8_t>(readLittleEndian(1)); }
+
+    uint16_t read16() { return static_cast<uint16_t>(readLittleEndian(2)); }
+
+    uint32_t read32() { return static_cast<uint32_t>(readLittleEndian(4)); }
+
+    uint64_t read64() { return readLittleEndian(8); }
+
+    bool readBool() { return read8() != 0; }
+
+    void read(gsl::span<uint8_t> bytes)
+    {
+        auto source = take(bytes.size());
+        std::copy(source.begin(), source.end(), bytes.begin());
+    }
+
+    bool isAtEnd() const { return position == data.size(); }
+
+private:
+    gsl::span<const uint8_t> data;
+    std::ptrdiff_t position = 0;
+
+    gsl::span<const uint8_t> take(std::ptrdiff_t size)
+    {
+        if (size > data.size() - position) {
+            throw std::runtime_error("Save state is truncated");
+        }
+        auto bytes = data.subspan(position, size);
+        position += size;
+        return bytes;
+    }
+
+    uint64_t readLittleEndian(int size)
+    {
+        uint64_t value = 0;
+        auto bytes = take(size);
+        for (int i = 0; i < size; ++i) {
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return value;
+    }
+};
+
+} // namespace
+
+static void write(StateWriter& out, const Cpu::State& state)
+{
+    for (auto reg : { state.af, state.bc, state.de, state.hl, state.sp, state.pc }) {
+        out.write(reg);
+    }
+    out.write(static_cast<uint8_t>(state.ime | state.isImeDelayed << 1 | state.imeDelayed << 2 | state.isHalted << 3));
+}
+
+static void read(StateReader& in, Cpu::State& state)
+{
+    for (auto reg : { &state.af, &state.bc, &state.de, &state.hl, &state.sp, &state.pc }) {
+        *reg = in.read16();
+    }
+    auto bits = in.read8();
+    state.ime = bits & 1;
+    state.isImeDelayed = bits & 2;
+    state.imeDelayed = bits & 4;
+    state.isHalted = bits & 8;
+}
+
+static void write(StateWriter& out, const Cartridge::State& state)
+{
+    out.write(state.headerHash);
+    out.write(static_cast<uint8_t>(state.isRamEnabled));
+    out.write(state.romBankRegister);
+    out.write(state.ramBankRegister);
+    out.write(static_cast<uint8_t>(state.isRamBankingMode));
+    out.write(state.ramSize);
+    out.write(gsl::make_span(state.ram.data(), state.ramSize));
+}
+
+static void read(StateReader& in, Cartridge::State& state)
+{
+    state.headerHash = in.read64();
+    state.isRamEnabled = in.readBool();
+    state.romBankRegister = in.read16();
+    state.ramBankRegister = in.read8();
+    state.isRamBankingMode = in.readBool();
+    state.ramSize = in.read32();
+    if (state.ramSize > state.ram.size()) {
+        throw std::runtime_error(fmt::format("Invalid cartridge RAM size in save state: 0x{:x}", state.ramSize));
+    }
+    in.read(gsl::make_span(state.ram.data(), state.ramSize));
+}
+
+static void write(StateWriter& out, const Mmu::State& state)
+{
+    out.write(state.memory);
+    out.write(static_cast<uint8_t>(state.isBootstrapMapped));
+    out.write(state.joypad);
+    write(out, state.cartridge);
+}
+
+static void read(StateReader& in, Mmu::State& state)
+{
+    in.read(state.memory);
+    state.isBootstrapMapped = in.readBool();
+    state.joypad = in.read8();
+    read(in, state.cartridge);
+}
+
+static void write(StateWriter& out, const Gpu::State& state)
+{
+    out.write(static_cast<uint8_t>(state.mode));
+    out.write(state.modeEnd);
+    out.write(state.colorIndices);
+}
+
+static void read(StateReader& in, Gpu::State& state)
+{
+    auto mode = in.read8();
+    if (mode > static_cast<uint8_t>(Mode::VramAccress)) {
+        throw std::runtime_error(fmt::format("Invalid GPU mode in save state: {}", mode));
+    }
+    state.mode = static_cast<Mode>(mode);
+    state.modeEnd = in.read64();
+    in.read(state.colorIndices);
+    for (auto index : state.colorIndices) {
+        if (index > 3 && index != Gpu::notRendered) {
+            throw std::runtime_error(fmt::format("Invalid color index in save state: {}", index));
+        }
+    }
+}
+
+static void write(StateWriter& out, const Scheduler::State& state)
+{
+    out.write(static_cast<uint8_t>(state.entryCount));
+    out.write(state.scheduled);
+    for (uint32_t i = 0; i < state.entryCount; ++i) {
+        out.write(state.entries[i].cycle);
+        out.write(state.entries[i].order);
+        out.write(static_cast<uint8_t>(state.entries[i].event));
+    }
+}
+
+static void read(StateReader& in, Scheduler::State& state)
+{
+    state.entryCount = in.read8();
+    if (state.entryCount > state.entries.size()) {
+        throw std::runtime_error(fmt::format("Too many scheduled events in save state: {}", state.entryCount));
+    }
+    state.scheduled = in.read64();
+    for (uint32_t i = 0; i < state.entryCount; ++i) {
+        state.entries[i].cycle = in.read64();
+        state.entries[i].order = in.read64();
+        auto event = in.read8();
+        if (event > static_cast<uint8_t>(Event::GpuModeEnd)) {
+            throw std::runtime_error(fmt::format("Invalid event in save state: {}", event));
+        }
+        state.entries[i].event = static_cast<Event>(event);
+    }
+}
+
+std::vector<uint8_t> serializeState(const MachineState& state)
+{
+    StateWriter out;
+    out.write(magic);
+    out.write(saveStateVersion);
+    write(out, state.cpu);
+    write(out, state.mmu);
+    write(out, state.gpu);
+    write(out, state.scheduler);
+    out.write(state.cycles);
+    out.write(state.frameCount);
+    out.write(state.instructionCount);
+    return std::move(out.data);
+}
+
+void deserializeState(gsl::span<const uint8_t> data, MachineState& state)
+{
+    StateReader in(data);
+    std::array<uint8_t, magic.size()> header;
+    in.read(header);
+    if (header != magic) {
+        throw std::runtime_error("Not a save state");
+    }
+    auto version = in.read32();
+    if (version != saveStateVersion) {
+        throw std::runtime_error(fmt::format("Save state version {} is not supported, expected {}", version, saveStateVersion));
+    }
+    read(in, state.cpu);
+    read(in, state.mmu);
+    read(in, state.gpu);
+    read(in, state.scheduler);
+    state.cycles = in.read64();
+    state.frameCount = in.read64();
+    state.instructionCount = in.read64();
+    if (!in.isAtEnd()) {
+        throw std::runtime_error("Save state has trailing data");
+    }
+}
@@ -0,0 +1,45 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+bool Scheduler::isLater(const Entry& a, const Entry& b)
+{
+    return a.cycle != b.cycle ? a.cycle > b.cycle : a.order > b.order;
+}
+
+void Scheduler::schedule(Event event, uint64_t cycle)
+{
+    entries.push_back({ cycle, scheduled++, event });
+    std::push_heap(entries.begin(), entries.end(), isLater);
+}
+
+std::optional<Event> Scheduler::popDue(uint64_t cycle)
+{
+    if (getNextDeadline() > cycle) {
+        return {};
+    }
+    std::pop_heap(entries.begin(), entries.end(), isLater);
+    auto event = entries.back().event;
+    entries.pop_back();
+    return event;
+}
+
+void Scheduler::saveState(State& state) const
+{
+    if (entries.size() > state.entries.size()) {
+        throw std::runtime_error("Too many scheduled events to save state");
+    }
+    std::copy(entries.begin(), entries.end(), state.entries.begin());
+    state.entryCount = static_cast<uint32_t>(entries.size());
+    state.scheduled = scheduled;
+}
+
+void Scheduler::loadState(const State& state)
+{
+    if (state.entryCount > state.entries.size()) {
+        throw std::runtime_error("Invalid scheduler state");
+    }
+    entries.assign(state.entries.begin(), state.entries.begin() + state.entryCount);
+    scheduled = state.scheduled;
+}
@@ -1,8 +1,34 @@
 #include "screen.h"
 #include "ui_screen.h"
 
+#include <QKeyEvent>
 #include <QSettings>
 
+// Joypad button mapped to key, 0 if there is none.
+static uint8_t getButton(int key)
+{
+    switch (key) {
+    case Qt::Key_Right:
+        return Mmu::buttonRight;
+    case Qt::Key_Left:
+        return Mmu::buttonLeft;
+    case Qt::Key_Up:
+        return Mmu::buttonUp;
+    case Qt::Key_Down:
+        return Mmu::buttonDown;
+    case Qt::Key_X:
+        return Mmu::buttonA;
+    case Qt::Key_Z:
+        return Mmu::buttonB;
+    case Qt::Key_Backspace:
+        return Mmu::buttonSelect;
+    case Qt::Key_Return:
+        return Mmu::buttonStart;
+    default:
+        return 0;
+    }
+}
+
 Screen::Screen(const Emulator& emu, QWidget* parent)
     : QMainWindow(parent)
     , emulator(emu)
@@ -16,7 +42,7 @@ Screen::Screen(const Emulator& emu, QWidget* parent)
 
 void Screen::redraw()
 {
-    auto buffer = emulator.getGpu().getScreenBuffer();
+    const auto& buffer = emulator.getGpu().getScreenBuffer();
     QImage image(buffer.getData(), 160, 144, QImage::Format_RGB32);
     QPixmap pixmap = QPixmap::fromImage(image.scaled(size()));
     ui->labelVram->setPixmap(pixmap);
@@ -27,6 +53,28 @@ Screen::~Screen()
     delete ui;
 }
 
+void Screen::keyPressEvent(QKeyEvent* event)
+{
+    auto button = getButton(event->key());
+    if (button == 0 || event->isAutoRepeat()) {
+        QMainWindow::keyPressEvent(event);
+        return;
+    }
+    joypad |= button;
+    emit joypadChanged(joypad);
+}
+
+void Screen::keyReleaseEvent(QKeyEvent* event)
+{
+    auto button = getButton(event->key());
+    if (button == 0 || event->isAutoRepeat()) {
+        QMainWindow::keyReleaseEvent(event);
+        return;
+    }
+    joypad = static_cast<uint8_t>(joypad & ~button);
+    emit joypadChanged(joypad);
+}
+
 void Screen::resizeEvent(QResizeEvent* event)
 {
     ui->labelVram->resize(size());
@@ -0,0 +1,310 @@
+#include "jit.h"
+#include "machine.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+namespace fs = std::filesystem;
+
+static const char* usage = "Usage: gbemu-testroms [--jobs n] [--frames n] [--bootstrap path] [--jit] [--golden file [--update-golden] [--png-dir path]] [directory]";
+
+struct Options {
+    std::string directory = "../gbemu/res/cpu_instrs/individual";
+    std::string bootstrapFilename = "../gbemu/res/bootstrap.bin"; // Same as emulator
+    uint64_t frames = 60 * 60; // Slowest ROMs report after about a minute of emulated time
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool jit = false; // Run ROMs with compiled code, which must give the same results
+    std::string goldenFilename; // Check frame hashes instead of serial output if set
+    bool updateGolden = false;
+    std::string pngDirectory = ".";
+};
+
+// ROM with the hash of its screen after running for a number of frames from power on.
+struct GoldenFrame {
+    std::string rom; // Relative to the golden file
+    uint64_t frames = 0;
+    uint64_t hash = 0;
+};
+
+struct Golden {
+    std::string header; // Comment lines before the first ROM, kept when hashes are updated
+    std::vector<GoldenFrame> frames;
+};
+
+struct Result {
+    std::string status; // Passed, Failed, Timeout, Stopped, Mismatch, Same, Updated or error message
+    std::string serialOutput; // Or details of a golden frame mismatch
+    uint64_t frames = 0;
+    double seconds = 0;
+};
+
+static Options parseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(fmt::format("Missing value for {}.\n{}", arg, usage));
+            }
+            return argv[++i];
+        };
+        if (arg == "--jobs") {
+            options.jobs = std::max(1u, static_cast<unsigned int>(std::stoul(value())));
+        } else if (arg == "--frames") {
+            options.frames = std::stoull(value());
+        } else if (arg == "--bootstrap") {
+            options.bootstrapFilename = value();
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg == "--golden") {
+            options.goldenFilename = value();
+        } else if (arg == "--update-golden") {
+            options.updateGolden = true;
+        } else if (arg == "--png-dir") {
+            options.pngDirectory = value();
+        } else if (arg[0] != '-') {
+            options.directory = arg;
+        } else {
+            throw std::runtime_error(fmt::format("Unknown argument {}.\n{}", arg, usage));
+        }
+    }
+    if (options.updateGolden && options.goldenFilename.empty()) {
+        throw std::runtime_error(fmt::format("--update-golden needs --golden.\n{}", usage));
+    }
+    return options;
+}
+
+// Golden file has a "frames hash rom" line per ROM, lines starting with # are comments.
+static Golden readGolden(const std::string& path)
+{
+    std::ifstream input(path);
+    if (input.fail()) {
+        throw std::runtime_error("Couldn't open file: " + path);
+    }
+    Golden golden;
+    for (std::string line; std::getline(input, line);) {
+        if (line.empty() || line[0] == '#') {
+            if (golden.frames.empty()) {
+                golden.header += line + "\n";
+            }
+            continue;
+        }
+        std::istringstream fields(line);
+        GoldenFrame frame;
+        fields >> frame.frames >> std::hex >> frame.hash >> std::ws;
+        std::getline(fields, frame.rom); // ROM names can have spaces
+        if (fields.fail() || frame.rom.empty()) {
+            throw std::runtime_error(fmt::format("Invalid line in {}: {}", path, line));
+        }
+        golden.frames.push_back(frame);
+    }
+    return golden;
+}
+
+// Comments after the first ROM aren't kept.
+static void writeGolden(const std::string& path, const Golden& golden)
+{
+    std::string text = golden.header;
+    for (const auto& frame : golden.frames) {
+        text += fmt::format("{} {:016x} {}\n", frame.frames, frame.hash, frame.rom);
+    }
+    writeFile(path, gsl::make_span(reinterpret_cast<const uint8_t*>(text.data()), text.size()));
+}
+
+// Call run with indices 0 to count - 1 on jobs threads. Workers take the next index until none
+// are left, so run must only share read only data between indices.
+static void runParallel(size_t count, unsigned int jobs, const std::function<void(size_t)>& run)
+{
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> workers;
+    for (auto i = 0u; i < std::min<size_t>(jobs, count); ++i) {
+        workers.emplace_back([&] {
+            for (size_t index; (index = next++) < count;) {
+                run(index);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Run test ROM on its own machine until it reports a result over serial link.
+static Result runRom(const std::string& path, const std::vector<uint8_t>& bootstrap, const Options& options)
+{
+    auto start = std::chrono::steady_clock::now();
+    Result result;
+    try {
+        Machine machine{ bootstrap, Rom::open(path) };
+        if (options.jit) {
+            machine.getCpu().setJitEnabled(true);
+        }
+        const std::string& serial = machine.getMmu().getSerialOutput();
+        result.status = "Timeout";
+        size_t checkedSize = 0;
+        while (machine.getFrameCount() < options.frames) {
+            if (machine.runFrame() == StepResult::Stopped) {
+                result.status = "Stopped";
+                break;
+            }
+            if (serial.size() == checkedSize) {
+                continue;
+            }
+            checkedSize = serial.size();
+            if (serial.find("Passed") != std::string::npos) {
+                result.status = "Passed";
+                break;
+            }
+            if (serial.find("Failed") != std::string::npos) {
+                result.status = "Failed";
+                break;
+            }
+        }
+        result.serialOutput = serial;
+        result.frames = machine.getFrameCount();
+    } catch (const std::exception& e) {
+        result.status = e.what();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Run ROM for exactly the frames of golden and compare the hash of its screen. On a mismatch the
+// screen is saved as a PNG named after the ROM, unless the golden hash is being updated.
+static Result runGolden(const std::string& path, const std::vector<uint8_t>& bootstrap, GoldenFrame& golden, const Options& options)
+{
+    auto start = std::chrono::steady_clock::now();
+    Result result;
+    try {
+        Machine machine{ bootstrap, Rom::open(path) };
+        if (options.jit) {
+            machine.getCpu().setJitEnabled(true);
+        }
+        while (machine.getFrameCount() < golden.frames && machine.runFrame() != StepResult::Stopped) {
+        }
+        result.frames = machine.getFrameCount();
+        auto hash = machine.getFrameHash();
+        if (options.updateGolden) {
+            result.status = hash == golden.hash ? "Same" : "Updated";
+            golden.hash = hash;
+        } else if (hash == golden.hash) {
+            result.status = "Passed";
+        } else {
+            result.status = "Mismatch";
+            const Image& screen = machine.getGpu().getScreenBuffer();
+            auto png = encodePng(gsl::make_span(screen.getData(), screen.getSize()), screen.getWidth(), screen.getHeight());
+            auto pngPath = fs::path(options.pngDirectory) / fs::path(path).filename().replace_extension(".png");
+            writeFile(pngPath.string(), png);
+            result.serialOutput = fmt::format("Expected {:016x}, got {:016x}, screen saved to {}", golden.hash, hash, pngPath.string());
+        }
+    } catch (const std::exception& e) {
+        result.status = e.what();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Check that every ROM in the golden file still renders the same screen, or update their hashes.
+// Only hashes are stored, so the check is fast enough to run on every commit.
+static int checkGolden(const Options& options, const std::vector<uint8_t>& bootstrap)
+{
+    auto golden = readGolden(options.goldenFilename);
+    auto& frames = golden.frames;
+    if (frames.empty()) {
+        throw std::runtime_error("No ROMs listed in " + options.goldenFilename);
+    }
+    auto directory = fs::path(options.goldenFilename).parent_path();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Result> results(frames.size());
+    runParallel(frames.size(), options.jobs, [&](size_t i) {
+        results[i] = runGolden((directory / frames[i].rom).string(), bootstrap, frames[i], options);
+    });
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t passed = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const auto& result = results[i];
+        fmt::print("{:<8} {:<40} {:>6} frames {:>7.2f} s\n", result.status, frames[i].rom, result.frames, result.seconds);
+        if (result.status == "Passed" || result.status == "Same" || result.status == "Updated") {
+            ++passed;
+        } else if (!result.serialOutput.empty()) {
+            fmt::print("{}\n", result.serialOutput);
+        }
+    }
+    if (options.updateGolden && passed == frames.size()) {
+        writeGolden(options.goldenFilename, golden);
+    }
+    fmt::print("{}/{} {} in {:.2f} s\n", passed, frames.size(), options.updateGolden ? "updated" : "matched", seconds);
+    return passed == frames.size() ? 0 : 2;
+}
+
+// Run all ROMs in a directory concurrently and report which of them passed, or check their screens
+// against golden frame hashes.
+int main(int argc, char** argv)
+{
+    try {
+        spdlog::set_level(spdlog::level::warn);
+        spdlog::set_pattern("[%H:%M:%S] %v");
+        auto options = parseOptions(argc, argv);
+        if (options.jit && !JitCompiler::isSupported()) {
+            spdlog::warn("JIT is not supported on this host, using the interpreter.");
+            options.jit = false;
+        }
+        if (!options.goldenFilename.empty()) {
+            return checkGolden(options, readFile(options.bootstrapFilename));
+        }
+
+        std::vector<std::string> roms;
+        for (const auto& entry : fs::directory_iterator(options.directory)) {
+            if (entry.path().extension() == ".gb") {
+                roms.push_back(entry.path().string());
+            }
+        }
+        std::sort(roms.begin(), roms.end());
+        if (roms.empty()) {
+            throw std::runtime_error("No ROMs found in " + options.directory);
+        }
+        auto bootstrap = readFile(options.bootstrapFilename);
+
+        // Each ROM runs on its own machine, the only shared data is the read only boot ROM.
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Result> results(roms.size());
+        runParallel(roms.size(), options.jobs, [&](size_t rom) { results[rom] = runRom(roms[rom], bootstrap, options); });
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t passed = 0;
+        for (size_t i = 0; i < roms.size(); ++i) {
+            const auto& result = results[i];
+            fmt::print("{:<8} {:<40} {:>6} frames {:>7.2f} s\n", result.status, fs::path(roms[i]).filename().string(), result.frames, result.seconds);
+            if (result.status == "Passed") {
+                ++passed;
+            } else if (!result.serialOutput.empty()) {
+                // End of the output has the failure details, ROMs which restart repeat their name.
+                static const size_t maxOutput = 256;
+                auto begin = result.serialOutput.size() - std::min(result.serialOutput.size(), maxOutput);
+                fmt::print("{}\n", result.serialOutput.substr(begin));
+            }
+        }
+        fmt::print("{}/{} passed in {:.2f} s\n", passed, roms.size(), seconds);
+        return passed == roms.size() ? 0 : 2;
+    } catch (const std::exception& e) {
+        spdlog::error(e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,29 @@
+#include "tilecache.h"
+
+#include "pixeldecoder.h"
+
+static_assert(sizeof(Tile) == linesPerTile * pixelsPerLine, "Tile lines must be contiguous to be decoded at once");
+
+TileLine decodeTileLine(uint8_t low, uint8_t high)
+{
+    uint8_t planes[] = { low, high };
+    TileLine line;
+    decodeTileRows(planes, 1, line.data());
+    return line;
+}
+
+TileCache::TileCache()
+    : tiles()
+{
+    dirty.set();
+}
+
+const Tile& TileCache::get(gsl::span<const uint8_t> tileData, unsigned int tile)
+{
+    if (dirty[tile]) {
+        auto data = tileData.subspan(tile * bytesPerTile, bytesPerTile);
+        decodeTileRows(data.data(), linesPerTile, tiles[tile][0].data());
+        dirty.reset(tile);
+    }
+    return tiles[tile];
+}
@@ -4,22 +4,17 @@ Timer::Timer()
 {
 }
 
-int Timer::getCycles() const
+uint64_t Timer::getCycles() const
 {
     return cycles;
 };
 
-void Timer::setCycles(int n)
-{
-    cycles = n;
-};
-
-void Timer::increment(int n)
+void Timer::increment(uint64_t n)
 {
     cycles += n;
 }
 
-void Timer::reset()
+void Timer::setCycles(uint64_t n)
 {
-    cycles = 0;
+    cycles = n;
 }
@@ -1,34 +1,24 @@
 #include "utils.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
 
 #include "fmt/format.h"
 
-using json = nlohmann::json;
+#include "opcodes.inc"
 
-static json opcodes = readOpcodes();
-
-std::string Instruction::bytesToString()
+BufferReader::BufferReader(gsl::span<const uint8_t> buffer)
+    : buffer(buffer)
 {
-    std::stringstream bytes;
-    for (auto byte : this->bytes) {
-        bytes << fmt::format("{:02X} ", byte);
-    }
-    return bytes.str();
 }
 
-std::string Instruction::operandsToString()
+uint8_t BufferReader::read(uint16_t address) const
 {
-    std::stringstream operands;
-    if (operand1) {
-        operands << *operand1;
-    }
-    if (operand2) {
-        operands << "," << *operand2;
-    }
-    return operands.str();
+    return address < buffer.size() ? buffer[address] : 0;
 }
 
 std::vector<uint8_t> readFile(const std::string& path)
@@ -42,116 +32,303 @@ std::vector<uint8_t> readFile(const std::string& path)
     return std::vector<uint8_t>{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
 }
 
-bool isHalfCarryAddition(uint8_t n, uint8_t m)
+void writeFile(const std::string& path, gsl::span<const uint8_t> data)
 {
-    return ((n & 0xf) + (m & 0xf)) > 0xf;
+    std::ofstream output(path, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (output.fail()) {
+        throw std::runtime_error("Couldn't write file: " + path);
+    }
 }
 
-bool isHalfCarrySubtraction(int8_t n, int8_t m)
+uint64_t hashBytes(gsl::span<const uint8_t> data, uint64_t hash)
 {
-    return (n & 0xf) - (m & 0xf) < 0;
+    for (auto byte : data) {
+        hash ^= byte;
+        hash *= 0x100000001b3;
+    }
+    return hash;
 }
 
-bool isHalfCarryAddition16(uint16_t n, uint16_t m)
+namespace {
+
+constexpr uint64_t xxPrime1 = 0x9E3779B185EBCA87;
+constexpr uint64_t xxPrime2 = 0xC2B2AE3D27D4EB4F;
+constexpr uint64_t xxPrime3 = 0x165667B19E3779F9;
+constexpr uint64_t xxPrime4 = 0x85EBCA77C2B2AE63;
+constexpr uint64_t xxPrime5 = 0x27D4EB2F165667C5;
+
+constexpr uint64_t rotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+// Little endian regardless of host.
+template <typename T>
+T readLittle(const uint8_t* bytes)
 {
-    return ((n & 0xfff) + (m & 0xfff)) > 0xfff;
+    T value;
+    std::memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if constexpr (sizeof(T) == 8) {
+        value = __builtin_bswap64(value);
+    } else {
+        value = __builtin_bswap32(value);
+    }
+#endif
+    return value;
+}
+
+uint64_t xxRound(uint64_t accumulator, uint64_t input)
+{
+    return rotateLeft(accumulator + input * xxPrime2, 31) * xxPrime1;
 }
 
-bool isBitSet(uint8_t n, uint8_t byte)
+uint64_t xxMerge(uint64_t hash, uint64_t accumulator)
+{
+    return (hash ^ xxRound(0, accumulator)) * xxPrime1 + xxPrime4;
+}
+
+} // namespace
+
+uint64_t xxHash64(gsl::span<const uint8_t> data, uint64_t seed)
 {
-    if (n > 7) {
-        throw std::invalid_argument("n must be between 0 and 7.");
+    const uint8_t* bytes = data.data();
+    const uint8_t* end = bytes + data.size();
+    uint64_t hash;
+    if (data.size() >= 32) {
+        // 4 independent lanes, so rounds of different lanes overlap in the pipeline.
+        uint64_t lanes[4] = { seed + xxPrime1 + xxPrime2, seed + xxPrime2, seed, seed - xxPrime1 };
+        for (; end - bytes >= 32; bytes += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                lanes[lane] = xxRound(lanes[lane], readLittle<uint64_t>(bytes + 8 * lane));
+            }
+        }
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (auto lane : lanes) {
+            hash = xxMerge(hash, lane);
+        }
+    } else {
+        hash = seed + xxPrime5;
+    }
+    hash += data.size();
+
+    for (; end - bytes >= 8; bytes += 8) {
+        hash = rotateLeft(hash ^ xxRound(0, readLittle<uint64_t>(bytes)), 27) * xxPrime1 + xxPrime4;
     }
-    return (byte >> n) & 1;
+    if (end - bytes >= 4) {
+        hash = rotateLeft(hash ^ readLittle<uint32_t>(bytes) * xxPrime1, 23) * xxPrime2 + xxPrime3;
+        bytes += 4;
+    }
+    for (; bytes < end; ++bytes) {
+        hash = rotateLeft(hash ^ *bytes * xxPrime5, 11) * xxPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= xxPrime2;
+    hash ^= hash >> 29;
+    hash *= xxPrime3;
+    hash ^= hash >> 32;
+    return hash;
 }
 
-uint16_t concatBytes(uint8_t lo, uint8_t hi)
+namespace {
+
+void appendBigEndian32(std::vector<uint8_t>& out, uint32_t value)
 {
-    return static_cast<uint16_t>(hi << 8) | lo;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
 }
 
-std::optional<json> getOpcodeData(uint8_t unprefixedOpcode, uint8_t prefixedOpcode)
+uint32_t crc32(const uint8_t* bytes, size_t size)
 {
-    bool isPrefixed = unprefixedOpcode == 0xCB;
-    std::string commandType = isPrefixed ? "cbprefixed" : "unprefixed";
-    uint8_t opcode = isPrefixed ? prefixedOpcode : unprefixedOpcode;
-    std::string opcodeHex = fmt::format("{:#02x}", opcode);
-    if (!opcodes.at(commandType).contains(opcodeHex)) {
-        return {}; // Unimplemented
+    static const auto table = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < table.size(); ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }();
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
     }
-    return opcodes.at(commandType).at(opcodeHex);
+    return crc ^ 0xFFFFFFFF;
 }
 
-json readOpcodes()
+// Chunk is length, type, data and CRC of type and data.
+void appendPngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
 {
-    std::string path = "../gbemu/lib/opcodes/opcodes.json";
-    std::ifstream input(path);
-    if (input.fail()) {
-        throw std::runtime_error("Couldn't open file: " + path);
+    appendBigEndian32(out, static_cast<uint32_t>(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    appendBigEndian32(out, crc32(&out[start], out.size() - start));
+}
+
+} // namespace
+
+std::vector<uint8_t> encodePng(gsl::span<const uint8_t> pixels, unsigned int width, unsigned int height)
+{
+    if (pixels.size() != 4 * static_cast<std::ptrdiff_t>(width) * height) {
+        throw std::runtime_error("Image size doesn't match its dimensions");
     }
-    json opcodes;
-    input >> opcodes;
-    return opcodes;
+
+    // Rows start with filter type 0 (none).
+    std::vector<uint8_t> raw;
+    raw.reserve((3 * width + 1) * height);
+    for (unsigned int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        for (unsigned int x = 0; x < width; ++x) {
+            auto pixel = &pixels[4 * (y * width + x)];
+            raw.insert(raw.end(), pixel, pixel + 3);
+        }
+    }
+
+    // Zlib stream of stored deflate blocks, which hold at most 0xFFFF bytes each.
+    std::vector<uint8_t> zlib{ 0x78, 0x01 };
+    size_t offset = 0;
+    do {
+        auto size = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 0xFFFF));
+        auto inverse = static_cast<uint16_t>(~size);
+        bool isLast = offset + size == raw.size();
+        zlib.insert(zlib.end(), { static_cast<uint8_t>(isLast), static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                                    static_cast<uint8_t>(inverse), static_cast<uint8_t>(inverse >> 8) });
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+    uint32_t a = 1, b = 0;
+    for (auto byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian32(zlib, b << 16 | a);
+
+    std::vector<uint8_t> header;
+    appendBigEndian32(header, width);
+    appendBigEndian32(header, height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bits per channel, RGB, no interlacing
+
+    std::vector<uint8_t> png{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    appendPngChunk(png, "IHDR", header);
+    appendPngChunk(png, "IDAT", zlib);
+    appendPngChunk(png, "IEND", {});
+    return png;
 }
 
-std::optional<std::string> readOperandValue(const std::vector<uint8_t>& memory, uint16_t pc, const std::optional<std::string>& operand)
+const OpcodeData* getOpcodeData(uint8_t unprefixedOpcode, uint8_t prefixedOpcode)
 {
-    if (operand == "d8" || operand == "r8") {
-        return fmt::format("${:02x}", memory.at(pc + 1));
-    } else if (operand == "d16" || operand == "a16") {
-        return fmt::format("${:02x}{:02x}", memory.at(pc + 2), memory.at(pc + 1));
-    } else if (operand == "(a16)") {
-        return fmt::format("$({:02x}{:02x})", memory.at(pc + 2), memory.at(pc + 1));
+    const OpcodeData* opcode = unprefixedOpcode == 0xCB ? &cbprefixedOpcodes[prefixedOpcode] : &unprefixedOpcodes[unprefixedOpcode];
+    if (!opcode->mnemonic) {
+        return nullptr; // Unimplemented
     }
-    return operand;
+    return opcode;
 }
 
-Instruction disassemble(const std::vector<uint8_t>& memory, uint16_t pc)
+// Relative jumps have their operand shown as an absolute address.
+static bool isRelativeJump(uint8_t opcode)
+{
+    return opcode == 0x18 || opcode == 0x20 || opcode == 0x28 || opcode == 0x30 || opcode == 0x38;
+}
+
+Instruction disassemble(const MemoryReader& memory, uint16_t pc)
 {
     Instruction instr;
     instr.pc = pc;
-    auto opbytes = 1u;
-    if (auto opcode = getOpcodeData(memory.at(pc), memory.size() > pc + 1 ? memory.at(pc + 1) : 0)) {
-        instr.mnemonic = opcode->at("mnemonic");
-        opbytes = opcode->at("length");
-        if (opcode->contains("operand1")) {
-            instr.operand1 = opcode->at("operand1");
-        }
-        if (opcode->contains("operand2")) {
-            instr.operand2 = opcode->at("operand2");
-        }
+    instr.opcode = getOpcodeData(memory.read(pc), memory.read(pc + 1));
+    if (instr.opcode) {
+        instr.length = instr.opcode->length;
+    }
+    for (uint8_t i = 0; i < instr.length; ++i) {
+        instr.bytes[i] = memory.read(pc + i);
     }
-    for (uint8_t i = 0; i < opbytes; ++i) {
-        instr.bytes.push_back(memory.at(pc + i));
+
+    if (instr.bytes[0] == 0x18) {
+        instr.value = static_cast<uint16_t>(pc + 1 + static_cast<int8_t>(instr.bytes[1]));
+    } else if (isRelativeJump(instr.bytes[0])) {
+        instr.value = static_cast<uint16_t>(pc + 2 + static_cast<int8_t>(instr.bytes[1]));
+    } else if (instr.length == 2 && instr.bytes[0] != 0xCB) {
+        instr.value = instr.bytes[1];
+    } else if (instr.length == 3) {
+        instr.value = concatBytes(instr.bytes[1], instr.bytes[2]);
     }
+    return instr;
+}
 
-    instr.operand1 = readOperandValue(memory, pc, instr.operand1);
-    instr.operand2 = readOperandValue(memory, pc, instr.operand2);
+namespace {
+// Appends formatted text to a fixed size buffer, dropping text which doesn't fit.
+class TextWriter {
+public:
+    explicit TextWriter(gsl::span<char> buffer)
+        : begin(buffer.data())
+        , out(buffer.data())
+        , end(buffer.data() + buffer.size())
+    {
+    }
 
-    switch (memory.at(pc)) {
-    case 0xE0:
+    template <typename... Args>
+    void write(const char* format, const Args&... args)
+    {
+        out = fmt::format_to_n(out, static_cast<size_t>(end - out), format, args...).out;
+    }
+
+    std::string_view text() const { return { begin, static_cast<size_t>(out - begin) }; }
+
+private:
+    char* begin;
+    char* out;
+    char* end;
+};
+}
+
+std::string_view formatBytes(const Instruction& instr, gsl::span<char> buffer)
+{
+    TextWriter writer{ buffer };
+    for (uint8_t i = 0; i < instr.length; ++i) {
+        writer.write("{:02X} ", instr.bytes[i]);
+    }
+    return writer.text();
+}
+
+static void formatOperand(TextWriter& writer, const Instruction& instr, const char* operand, bool isFirst)
+{
+    auto opcode = instr.bytes[0];
+    std::string_view name = operand;
+    if (isRelativeJump(opcode) && name == "r8") {
+        writer.write("${:04x}", instr.value);
+    } else if (opcode == 0xE0 && isFirst) {
         // Put A into memory address $FF00+n.
-        instr.operand1 = fmt::format("($FF{:02x})", memory.at(pc + 1));
-        break;
-    case 0xE2:
+        writer.write("($FF{:02x})", instr.value);
+    } else if (opcode == 0xE2 && isFirst) {
         // Put A into address $FF00 + register C.
-        instr.operand1 = "($FF00+C)";
-        break;
-    case 0xF0:
-        instr.operand2 = fmt::format("($FF{:02x})", memory.at(pc + 1));
-        break;
-
-    // Relative jumps - print absolute address instead of relative.
-    case 0x18:
-        instr.operand1 = fmt::format("${:04x}", pc + 1 + static_cast<int8_t>(memory.at(pc + 1)));
-        break;
-    case 0x20:
-    case 0x28:
-    case 0x30:
-    case 0x38:
-        instr.operand2 = fmt::format("${:04x}", pc + 2 + static_cast<int8_t>(memory.at(pc + 1)));
-        break;
+        writer.write("($FF00+C)");
+    } else if (opcode == 0xF0 && !isFirst) {
+        writer.write("($FF{:02x})", instr.value);
+    } else if (name == "d8" || name == "r8") {
+        writer.write("${:02x}", instr.value);
+    } else if (name == "d16" || name == "a16") {
+        writer.write("${:04x}", instr.value);
+    } else if (name == "(a16)") {
+        writer.write("$({:04x})", instr.value);
+    } else {
+        writer.write("{}", operand);
     }
+}
 
-    return instr;
+std::string_view formatOperands(const Instruction& instr, gsl::span<char> buffer)
+{
+    TextWriter writer{ buffer };
+    if (!instr.opcode) {
+        return writer.text();
+    }
+    if (instr.opcode->operand1) {
+        formatOperand(writer, instr, instr.opcode->operand1, true);
+    }
+    if (instr.opcode->operand2) {
+        writer.write(",");
+        formatOperand(writer, instr, instr.opcode->operand2, false);
+    }
+    return writer.text();
 }
@@ -0,0 +1,104 @@
+#include <cartridge.h>
+#include <mmu.h>
+
+#include <catch.hpp>
+
+// Create ROM with given number of banks, each filled with its bank number.
+static std::vector<uint8_t> makeRom(uint8_t type, size_t banks, uint8_t ramSize = 0)
+{
+    std::vector<uint8_t> rom(banks * Cartridge::romBankSize);
+    for (size_t bank = 0; bank < banks; ++bank) {
+        std::fill_n(rom.begin() + static_cast<long>(bank * Cartridge::romBankSize), Cartridge::romBankSize, static_cast<uint8_t>(bank));
+    }
+    rom[0x147] = type;
+    rom[0x149] = ramSize;
+    return rom;
+}
+
+TEST_CASE("Cartridge type is read from header", "[cartridge]")
+{
+    REQUIRE(Cartridge{}.getMbc() == Mbc::None);
+    REQUIRE(Cartridge{ std::make_shared<const Rom>(makeRom(0x01, 4)) }.getMbc() == Mbc::Mbc1);
+    REQUIRE(Cartridge{ std::make_shared<const Rom>(makeRom(0x13, 4)) }.getMbc() == Mbc::Mbc3);
+    REQUIRE(Cartridge{ std::make_shared<const Rom>(makeRom(0x19, 4)) }.getMbc() == Mbc::Mbc5);
+}
+
+TEST_CASE("MBC1 switches ROM bank at 0x4000-0x7FFF", "[cartridge]")
+{
+    Mmu mmu;
+    mmu.loadCartridge(makeRom(0x01, 64));
+    REQUIRE(mmu.get(0x0000) == 0);
+    REQUIRE(mmu.get(0x4000) == 1);
+
+    mmu.set(0x2000, 3);
+    REQUIRE(mmu.get(0x4000) == 3);
+    REQUIRE(mmu.get(0x7FFF) == 3);
+
+    SECTION("Bank 0 selects bank 1")
+    {
+        mmu.set(0x2000, 0);
+        REQUIRE(mmu.get(0x4000) == 1);
+    }
+    SECTION("Upper bits are taken from RAM bank register")
+    {
+        mmu.set(0x4000, 1);
+        REQUIRE(mmu.get(0x4000) == 0x23);
+        REQUIRE(mmu.get(0x0000) == 0);
+    }
+    SECTION("Bank number wraps around ROM size")
+    {
+        mmu.set(0x4000, 3);
+        REQUIRE(mmu.get(0x4000) == 0x23);
+    }
+}
+
+TEST_CASE("ROM which isn't a whole number of banks is padded to the last bank", "[cartridge]")
+{
+    auto data = makeRom(0x01, 3);
+    data.resize(0x9000);
+    Mmu mmu;
+    mmu.loadCartridge(data);
+    mmu.set(0x2000, 2);
+    REQUIRE(mmu.get(0x4000) == 2);
+    REQUIRE(mmu.get(0x4FFF) == 2);
+    REQUIRE(mmu.get(0x5000) == 0);
+    REQUIRE(mmu.get(0x7FFF) == 0);
+}
+
+TEST_CASE("MBC5 can map ROM bank 0 and banks above 0xFF", "[cartridge]")
+{
+    Mmu mmu;
+    mmu.loadCartridge(makeRom(0x19, 512));
+    mmu.set(0x2000, 0);
+    REQUIRE(mmu.get(0x4000) == 0);
+    mmu.set(0x2000, 0x05);
+    mmu.set(0x3000, 0x01);
+    REQUIRE(mmu.get(0x4000) == 0x05); // Bank 0x105
+}
+
+TEST_CASE("External RAM is accessible only when enabled", "[cartridge]")
+{
+    Mmu mmu;
+    mmu.loadCartridge(makeRom(0x03, 4, 0x03)); // MBC1+RAM+BATTERY, 32 KiB RAM
+    mmu.set(0xA000, 0x12);
+    REQUIRE(mmu.get(0xA000) == 0xFF);
+
+    mmu.set(0x0000, 0x0A);
+    mmu.set(0xA000, 0x12);
+    REQUIRE(mmu.get(0xA000) == 0x12);
+
+    SECTION("RAM banks are switched in RAM banking mode")
+    {
+        mmu.set(0x6000, 1);
+        mmu.set(0x4000, 2);
+        REQUIRE(mmu.get(0xA000) == 0x00);
+        mmu.set(0xA000, 0x34);
+        mmu.set(0x4000, 0);
+        REQUIRE(mmu.get(0xA000) == 0x12);
+    }
+    SECTION("Disabling RAM unmaps it")
+    {
+        mmu.set(0x0000, 0x00);
+        REQUIRE(mmu.get(0xA000) == 0xFF);
+    }
+}
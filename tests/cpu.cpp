@@ -39,3 +39,297 @@ TEST_CASE("AF register can be set and retrieved", "[cpu]")
         REQUIRE(cpu.getAF() == 0x1234);
     }
 }
+
+TEST_CASE("Cpu dispatches opcodes through the opcode table", "[cpu]")
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+
+    SECTION("NOP takes 4 cycles and advances pc by 1")
+    {
+        REQUIRE(cpu.execute());
+        REQUIRE(cpu.getPC() == 1);
+        REQUIRE(timer.getCycles() == 4);
+    }
+    SECTION("Unimplemented opcode is reported")
+    {
+        mmu.loadCartridge({ 0xD3 });
+        REQUIRE(!cpu.execute());
+    }
+}
+
+TEST_CASE("Conditional jump takes extra cycles only when taken", "[cpu]")
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge({ 0x20, 0x02 }); // JR NZ,n
+
+    SECTION("Jump is taken when flag Z is reset")
+    {
+        REQUIRE(cpu.execute());
+        REQUIRE(cpu.getPC() == 4);
+        REQUIRE(timer.getCycles() == 12);
+    }
+    SECTION("Jump is not taken when flag Z is set")
+    {
+        cpu.setAF(Cpu::flagZ);
+        REQUIRE(cpu.execute());
+        REQUIRE(cpu.getPC() == 2);
+        REQUIRE(timer.getCycles() == 8);
+    }
+}
+
+TEST_CASE("Cpu runs until cycle budget is used up", "[cpu]")
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+
+    SECTION("Last instruction may exceed budget")
+    {
+        auto result = cpu.run(10);
+        REQUIRE(result.reason == StopReason::Budget);
+        REQUIRE(result.instructions == 3);
+        REQUIRE(result.cycles == 12);
+        REQUIRE(timer.getCycles() == 12);
+    }
+    SECTION("Instruction at breakpoint is not executed")
+    {
+        auto result = cpu.run(100, 2);
+        REQUIRE(result.reason == StopReason::Breakpoint);
+        REQUIRE(result.instructions == 2);
+        REQUIRE(result.cycles == 8);
+        REQUIRE(cpu.getPC() == 2);
+    }
+    SECTION("Unimplemented opcode stops execution")
+    {
+        mmu.loadCartridge(std::vector<uint8_t>{ 0x00, 0xD3 });
+        auto result = cpu.run(100);
+        REQUIRE(result.reason == StopReason::UnimplementedOpcode);
+        REQUIRE(result.instructions == 1);
+        REQUIRE(result.cycles == 4);
+    }
+}
+
+TEST_CASE("Flags are derived from the last operation when read", "[cpu]")
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge({ 0x3E, 0x10, 0xFE, 0x20, 0x3C, 0x3D, 0x3D }); // LD A,0x10; CP 0x20; INC A; DEC A; DEC A
+    auto execute = [&cpu](int count) {
+        for (int i = 0; i < count; ++i) {
+            REQUIRE(cpu.execute());
+        }
+    };
+
+    SECTION("CP sets N and C")
+    {
+        execute(2);
+        REQUIRE(cpu.getAF() == 0x1050);
+    }
+    SECTION("INC keeps C")
+    {
+        execute(3);
+        REQUIRE(cpu.getAF() == 0x1110);
+    }
+    SECTION("DEC sets H when borrowing from bit 4")
+    {
+        execute(5);
+        REQUIRE(cpu.getAF() == 0x0F70);
+    }
+    SECTION("Flags are replaced by setAF")
+    {
+        execute(2);
+        cpu.setAF(0x1234);
+        REQUIRE(cpu.getAF() == 0x1234);
+    }
+}
+
+TEST_CASE("HALT waits for an interrupt", "[cpu]")
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge({ 0x76, 0x00 }); // HALT; NOP
+
+    SECTION("Halted CPU sleeps until the end of the budget")
+    {
+        auto result = cpu.run(1000);
+        REQUIRE(result.reason == StopReason::Budget);
+        REQUIRE(result.instructions == 1);
+        REQUIRE(result.cycles == 1000);
+        REQUIRE(cpu.getPC() == 1);
+    }
+    SECTION("Requested interrupt wakes CPU up even when interrupts are disabled")
+    {
+        REQUIRE(cpu.execute());
+        REQUIRE(cpu.execute());
+        REQUIRE(cpu.getPC() == 1);
+        mmu.set(0xFFFF, 0x01);
+        mmu.set(0xFF0F, 0x01);
+        REQUIRE(cpu.execute());
+        REQUIRE(cpu.getPC() == 2);
+    }
+}
+
+TEST_CASE("Skipped idle loop leaves the same state as running it", "[cpu]")
+{
+    // LDH A,(0x80); CP 1; JR NZ,-6 - wait until HRAM is changed by something other than the CPU
+    const std::vector<uint8_t> rom{ 0xF0, 0x80, 0xFE, 0x01, 0x20, 0xFA };
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge(rom);
+    Mmu steppedMmu;
+    Timer steppedTimer;
+    Cpu steppedCpu{ steppedMmu, steppedTimer };
+    steppedMmu.loadCartridge(rom);
+
+    uint64_t instructions = 0;
+    for (auto budget : { 1000u, 999u, 17u }) {
+        instructions += cpu.run(budget).instructions;
+        auto end = steppedTimer.getCycles() + budget;
+        while (steppedTimer.getCycles() < end) {
+            REQUIRE(steppedCpu.execute());
+            --instructions;
+        }
+        REQUIRE(instructions == 0);
+        REQUIRE(timer.getCycles() == steppedTimer.getCycles());
+        REQUIRE(cpu.getPC() == steppedCpu.getPC());
+        REQUIRE(cpu.getAF() == steppedCpu.getAF());
+    }
+}
+
+TEST_CASE("Code in work RAM is decoded again after it changes", "[cpu]")
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge({ 0xC3, 0x00, 0xC0 }); // JP 0xC000
+    const std::vector<uint8_t> code{ 0x3E, 0x12, 0x18, 0xFC }; // LD A,0x12; JR -4
+    for (auto i = 0u; i < code.size(); ++i) {
+        mmu.set(static_cast<uint16_t>(0xC000 + i), code[i]);
+    }
+    auto execute = [&cpu](int count) {
+        for (int i = 0; i < count; ++i) {
+            REQUIRE(cpu.execute());
+        }
+    };
+    execute(3);
+    REQUIRE(cpu.getAF() >> 8 == 0x12);
+
+    mmu.set(0xC001, 0x34);
+    execute(2);
+    REQUIRE(cpu.getAF() >> 8 == 0x34);
+
+    mmu.set(0xE001, 0x56); // Echo RAM
+    execute(2);
+    REQUIRE(cpu.getAF() >> 8 == 0x56);
+}
+
+// Run rom with the JIT and with the interpreter in steps of various budgets, comparing their state.
+static void compareWithInterpreter(const std::vector<uint8_t>& rom)
+{
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge(rom);
+    if (!JitCompiler::isSupported()) {
+        REQUIRE_FALSE(cpu.setJitEnabled(true));
+        return;
+    }
+    REQUIRE(cpu.setJitEnabled(true));
+    Mmu interpretedMmu;
+    Timer interpretedTimer;
+    Cpu interpretedCpu{ interpretedMmu, interpretedTimer };
+    interpretedMmu.loadCartridge(rom);
+
+    for (auto budget : { 1000u, 999u, 17u, 5u, 100000u }) {
+        auto result = cpu.run(budget);
+        auto interpretedResult = interpretedCpu.run(budget);
+        REQUIRE(result.reason == StopReason::Budget);
+        REQUIRE(interpretedResult.reason == StopReason::Budget);
+        REQUIRE(result.instructions == interpretedResult.instructions);
+        REQUIRE(timer.getCycles() == interpretedTimer.getCycles());
+        REQUIRE(cpu.getPC() == interpretedCpu.getPC());
+        REQUIRE(cpu.getAF() == interpretedCpu.getAF());
+        REQUIRE(cpu.getBC() == interpretedCpu.getBC());
+        REQUIRE(mmu.get(0xC000) == interpretedMmu.get(0xC000));
+        REQUIRE(cpu.isJitEnabled());
+    }
+}
+
+TEST_CASE("Compiled code leaves the same state as the interpreter", "[cpu]")
+{
+    compareWithInterpreter({
+        0x06, 0x00, // LD B,0
+        0x3C, // INC A
+        0x87, // ADD A,A
+        0xEA, 0x00, 0xC0, // LD (0xC000),A
+        0x05, // DEC B
+        0x20, 0xF8, // JR NZ,-8
+        0x04, // INC B
+        0x18, 0xF5 // JR -11
+    });
+}
+
+TEST_CASE("Hot blocks starting with an instruction left to the interpreter keep the JIT on", "[cpu]")
+{
+    // Nothing of the loop body's block can be compiled, the rest of it after DI can.
+    compareWithInterpreter({
+        0x06, 0x00, // LD B,0
+        0xF3, // DI
+        0x3C, // INC A
+        0x87, // ADD A,A
+        0xEA, 0x00, 0xC0, // LD (0xC000),A
+        0x05, // DEC B
+        0x20, 0xF7, // JR NZ,-9
+        0x04, // INC B
+        0x18, 0xF4 // JR -12
+    });
+}
+
+TEST_CASE("Code in switched ROM banks runs the same compiled or interpreted", "[cpu]")
+{
+    // MBC1 ROM calling the same address in banks 1 and 2, which increment different registers.
+    std::vector<uint8_t> rom(4 * Cartridge::romBankSize);
+    const std::vector<uint8_t> bank0{
+        0x31, 0xFE, 0xDF, // LD SP,0xDFFE
+        0x3E, 0x01, // LD A,1
+        0xEA, 0x00, 0x20, // LD (0x2000),A
+        0xCD, 0x00, 0x40, // CALL 0x4000
+        0x3E, 0x02, // LD A,2
+        0xEA, 0x00, 0x20, // LD (0x2000),A
+        0xCD, 0x00, 0x40, // CALL 0x4000
+        0x18, 0xEE // JR -18
+    };
+    std::copy(bank0.begin(), bank0.end(), rom.begin());
+    rom[0x147] = 0x01;
+    rom[1 * Cartridge::romBankSize] = 0x04; // INC B
+    rom[1 * Cartridge::romBankSize + 1] = 0xC9; // RET
+    rom[2 * Cartridge::romBankSize] = 0x0C; // INC C
+    rom[2 * Cartridge::romBankSize + 1] = 0xC9; // RET
+
+    Mmu mmu;
+    Timer timer;
+    Cpu cpu{ mmu, timer };
+    mmu.loadCartridge(rom);
+    cpu.setJitEnabled(true);
+    Mmu interpretedMmu;
+    Timer interpretedTimer;
+    Cpu interpretedCpu{ interpretedMmu, interpretedTimer };
+    interpretedMmu.loadCartridge(rom);
+
+    for (auto budget : { 1000u, 100000u, 7u, 100000u }) {
+        cpu.run(budget);
+        interpretedCpu.run(budget);
+        REQUIRE(timer.getCycles() == interpretedTimer.getCycles());
+        REQUIRE(cpu.getPC() == interpretedCpu.getPC());
+        REQUIRE(cpu.getBC() == interpretedCpu.getBC());
+    }
+    // Both banks ran equally often, B and C differ by at most 1 modulo 256.
+    REQUIRE(static_cast<uint8_t>((cpu.getBC() >> 8) - (cpu.getBC() & 0xFF) + 1) <= 2);
+}
@@ -0,0 +1,109 @@
+#include <gpu.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <catch.hpp>
+
+// End HBlank and the OAM and VRAM access of the next line, which renders it.
+static void renderNextLine(Gpu& gpu, Scheduler& scheduler)
+{
+    for (auto i = 0; i < 3; ++i) {
+        REQUIRE(scheduler.popDue(Scheduler::never) == Event::GpuModeEnd);
+        gpu.endMode();
+    }
+}
+
+static uint8_t getPixel(const Image& image, unsigned int x, unsigned int y)
+{
+    return image.getData()[bytesPerPixel * (y * image.getWidth() + x)];
+}
+
+TEST_CASE("Scanline is rendered into framebuffer at the end of VRAM access", "[gpu]")
+{
+    Mmu mmu;
+    Scheduler scheduler;
+    Gpu gpu{ mmu, scheduler };
+    // Tile 1 is light gray, background map points at tile 0 except for the second tile of each row.
+    for (uint16_t address = 0x8010; address < 0x8020; address += 2) {
+        mmu.set(address, 0xFF);
+    }
+    for (uint16_t address = 0x9801; address < 0x9C00; address += 32) {
+        mmu.set(address, 1);
+    }
+
+    renderNextLine(gpu, scheduler);
+    REQUIRE(mmu.get(0xFF44) == 1);
+    const auto& frame = gpu.getScreenBuffer();
+    REQUIRE(getPixel(frame, 7, 1) == 255);
+    REQUIRE(getPixel(frame, 8, 1) == 170);
+    REQUIRE(getPixel(frame, 15, 1) == 170);
+    REQUIRE(getPixel(frame, 16, 1) == 255);
+    REQUIRE(getPixel(frame, 8, 2) == 0); // Not rendered yet
+
+    // Scrolling applies to lines rendered after it changes.
+    mmu.set(0xFF43, 4);
+    renderNextLine(gpu, scheduler);
+    REQUIRE(getPixel(frame, 3, 2) == 255);
+    REQUIRE(getPixel(frame, 4, 2) == 170);
+    REQUIRE(getPixel(frame, 8, 1) == 170);
+}
+
+TEST_CASE("Background wraps around horizontally", "[gpu]")
+{
+    Mmu mmu;
+    Scheduler scheduler;
+    Gpu gpu{ mmu, scheduler };
+    for (uint16_t address = 0x8010; address < 0x8020; address += 2) {
+        mmu.set(address, 0xFF);
+    }
+    mmu.set(0x9820, 1); // First tile of the row with line 8
+
+    mmu.set(0xFF42, 7); // Line 1 shows background line 8
+    mmu.set(0xFF43, 0xFC);
+    renderNextLine(gpu, scheduler);
+    REQUIRE(getPixel(gpu.getScreenBuffer(), 3, 1) == 255);
+    REQUIRE(getPixel(gpu.getScreenBuffer(), 4, 1) == 170);
+    REQUIRE(getPixel(gpu.getScreenBuffer(), 11, 1) == 170);
+    REQUIRE(getPixel(gpu.getScreenBuffer(), 12, 1) == 255);
+}
+
+TEST_CASE("GPU schedules mode ends from the previous deadline", "[gpu]")
+{
+    Mmu mmu;
+    Scheduler scheduler;
+    Gpu gpu{ mmu, scheduler };
+    REQUIRE(scheduler.getNextDeadline() == 204);
+    for (auto deadline : { 284u, 456u, 660u }) { // OAM access, VRAM access, HBlank
+        scheduler.popDue(Scheduler::never);
+        gpu.endMode();
+        REQUIRE(scheduler.getNextDeadline() == deadline);
+    }
+}
+
+TEST_CASE("Restoring GPU state redraws the framebuffer from its color indices", "[gpu]")
+{
+    Mmu mmu;
+    Scheduler scheduler;
+    Gpu gpu{ mmu, scheduler };
+    for (uint16_t address = 0x8010; address < 0x8020; address += 2) {
+        mmu.set(address, 0xFF);
+    }
+    mmu.set(0x9821, 1);
+    for (auto line = 0; line < 10; ++line) {
+        renderNextLine(gpu, scheduler);
+    }
+    const auto& frame = gpu.getScreenBuffer();
+    std::vector<uint8_t> saved(frame.getData(), frame.getData() + frame.getSize());
+    Gpu::State state;
+    gpu.saveState(state);
+
+    mmu.set(0x9821, 0);
+    for (auto line = 0; line < 10; ++line) {
+        renderNextLine(gpu, scheduler);
+    }
+    gpu.loadState(state);
+    REQUIRE(std::equal(saved.begin(), saved.end(), frame.getData()));
+    REQUIRE(getPixel(frame, 8, 9) == 170);
+    REQUIRE(getPixel(frame, 8, 12) == 0); // Not rendered
+}
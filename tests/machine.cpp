@@ -0,0 +1,56 @@
+#include <machine.h>
+
+#include <catch.hpp>
+
+// Boot ROM which loops forever with JR -2.
+static std::vector<uint8_t> makeLoopingBootstrap()
+{
+    std::vector<uint8_t> bootstrap(0x100, 0);
+    bootstrap[0] = 0x18;
+    bootstrap[1] = 0xFE;
+    return bootstrap;
+}
+
+TEST_CASE("Machine runs frames", "[machine]")
+{
+    Machine machine{ makeLoopingBootstrap(), std::make_shared<const Rom>(std::vector<uint8_t>{}) };
+    REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+    REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+    REQUIRE(machine.getFrameCount() == 2);
+    REQUIRE(machine.getInstructionCount() > 0);
+    REQUIRE(machine.getCpu().getPC() == 0);
+}
+
+TEST_CASE("Machine stops on unimplemented opcode", "[machine]")
+{
+    auto bootstrap = makeLoopingBootstrap();
+    bootstrap[0] = 0xD3;
+    Machine machine{ bootstrap, std::make_shared<const Rom>(std::vector<uint8_t>{}) };
+    REQUIRE(machine.runFrame() == StepResult::Stopped);
+    REQUIRE(machine.getInstructionCount() == 0);
+    REQUIRE(machine.getFrameCount() == 0);
+}
+
+TEST_CASE("Machines running the same program have the same state hash", "[machine]")
+{
+    Machine first{ makeLoopingBootstrap(), std::make_shared<const Rom>(std::vector<uint8_t>{}) };
+    Machine second{ makeLoopingBootstrap(), std::make_shared<const Rom>(std::vector<uint8_t>{}) };
+    REQUIRE(first.getStateHash() == second.getStateHash());
+
+    first.getMmu().set(0xC000, 1);
+    REQUIRE(first.getStateHash() != second.getStateHash());
+    REQUIRE(first.getFrameHash() == second.getFrameHash());
+}
+
+TEST_CASE("Machine stops frame at breakpoint", "[machine]")
+{
+    auto bootstrap = makeLoopingBootstrap();
+    bootstrap[0] = 0x00; // NOP, then loop at 1
+    bootstrap[1] = 0x18;
+    bootstrap[2] = 0xFE;
+    Machine machine{ bootstrap, std::make_shared<const Rom>(std::vector<uint8_t>{}) };
+    REQUIRE(machine.runFrame(1) == StepResult::Breakpoint);
+    REQUIRE(machine.getCpu().getPC() == 1);
+    REQUIRE(machine.getInstructionCount() == 1);
+    REQUIRE(machine.getFrameCount() == 0);
+}
@@ -0,0 +1,141 @@
+#include <mmu.h>
+
+#include <memory>
+
+#include <catch.hpp>
+
+TEST_CASE("Memory values can be set and retrieved", "[mmu]")
+{
+    Mmu mmu;
+    mmu.set(0xC000, 0x12);
+    mmu.set(0xFF80, 0x34);
+    mmu.set(0xFFFF, 0x56);
+    REQUIRE(mmu.get(0xC000) == 0x12);
+    REQUIRE(mmu.get(0xFF80) == 0x34);
+    REQUIRE(mmu.get(0xFFFF) == 0x56);
+}
+
+TEST_CASE("Echo RAM mirrors work RAM", "[mmu]")
+{
+    Mmu mmu;
+    mmu.set(0xC123, 0x12);
+    REQUIRE(mmu.get(0xE123) == 0x12);
+    mmu.set(0xFDFF, 0x34);
+    REQUIRE(mmu.get(0xDDFF) == 0x34);
+}
+
+TEST_CASE("Cartridge ROM is read only", "[mmu]")
+{
+    Mmu mmu;
+    mmu.loadCartridge({ 0x12 });
+    mmu.set(0x0000, 0x34);
+    REQUIRE(mmu.get(0x0000) == 0x12);
+}
+
+TEST_CASE("Bootstrap ROM is mapped over cartridge until unmapped", "[mmu]")
+{
+    Mmu mmu;
+    std::vector<uint8_t> cartridge(0x200, 0x12);
+    mmu.loadCartridge(cartridge);
+    mmu.loadBootstrap(std::vector<uint8_t>(0x100, 0x34));
+
+    REQUIRE(mmu.get(0x0000) == 0x34);
+    REQUIRE(mmu.get(0x00FF) == 0x34);
+    REQUIRE(mmu.get(0x0100) == 0x12);
+
+    mmu.set(0xFF50, 0x01);
+    REQUIRE(mmu.get(0x0000) == 0x12);
+    REQUIRE(mmu.get(0x00FF) == 0x12);
+}
+
+TEST_CASE("Serial transfers are captured", "[mmu]")
+{
+    Mmu mmu;
+    for (auto c : { 'O', 'K' }) {
+        mmu.set(0xFF01, static_cast<uint8_t>(c));
+        mmu.set(0xFF02, 0x81);
+    }
+    mmu.set(0xFF02, 0x01); // Transfer not started
+    REQUIRE(mmu.getSerialOutput() == "OK");
+}
+
+TEST_CASE("Writes to tile data update decoded tiles", "[mmu]")
+{
+    Mmu mmu;
+    REQUIRE(mmu.getTile(383)[7] == TileLine{ 0, 0, 0, 0, 0, 0, 0, 0 });
+    mmu.set(0x97FF, 0x80); // High plane of the last line of the last tile
+    REQUIRE(mmu.get(0x97FF) == 0x80);
+    REQUIRE(mmu.getTile(383)[7] == TileLine{ 2, 0, 0, 0, 0, 0, 0, 0 });
+}
+
+TEST_CASE("Writes to watched code change its version once", "[mmu]")
+{
+    Mmu mmu;
+    mmu.watchCode(0xC123);
+    auto version = mmu.getCodeVersion(0xC100);
+    auto epoch = mmu.getCodeEpoch();
+
+    SECTION("Write to the page")
+    {
+        mmu.set(0xC1FF, 0x12);
+        REQUIRE(mmu.get(0xC1FF) == 0x12);
+        REQUIRE(mmu.getCodeVersion(0xC100) == version + 1);
+        REQUIRE(mmu.getCodeEpoch() == epoch + 1);
+        mmu.set(0xC1FF, 0x34);
+        REQUIRE(mmu.get(0xC1FF) == 0x34);
+        REQUIRE(mmu.getCodeVersion(0xC100) == version + 1);
+    }
+    SECTION("Write through echo RAM")
+    {
+        mmu.set(0xE100, 0x12);
+        REQUIRE(mmu.get(0xC100) == 0x12);
+        REQUIRE(mmu.getCodeVersion(0xC100) == version + 1);
+    }
+    SECTION("Write to another page")
+    {
+        mmu.set(0xC200, 0x12);
+        REQUIRE(mmu.getCodeVersion(0xC100) == version);
+        REQUIRE(mmu.getCodeEpoch() == epoch);
+    }
+}
+
+TEST_CASE("Restoring state changes the version of work RAM code only", "[mmu]")
+{
+    Mmu mmu;
+    auto state = std::make_unique<Mmu::State>();
+    mmu.saveState(*state);
+    auto romVersion = mmu.getCodeVersion(0x4000);
+    auto ramVersion = mmu.getCodeVersion(0xD000);
+    auto epoch = mmu.getCodeEpoch();
+
+    mmu.loadState(*state);
+    REQUIRE(mmu.getCodeVersion(0x4000) == romVersion);
+    REQUIRE(mmu.getCodeVersion(0xD000) == ramVersion + 1);
+    REQUIRE(mmu.getCodeEpoch() != epoch);
+}
+
+TEST_CASE("Joypad register shows buttons on selected lines", "[mmu]")
+{
+    Mmu mmu;
+    REQUIRE(mmu.get(0xFF00) == 0xCF);
+    mmu.setJoypad(Mmu::buttonRight | Mmu::buttonStart);
+    mmu.set(0xFF0F, 0x00);
+
+    mmu.set(0xFF00, 0x20); // Directions
+    REQUIRE(mmu.get(0xFF00) == 0xEE);
+    mmu.set(0xFF00, 0x10); // Other buttons
+    REQUIRE(mmu.get(0xFF00) == 0xD7);
+    mmu.set(0xFF00, 0x30); // Nothing
+    REQUIRE(mmu.get(0xFF00) == 0xFF);
+    mmu.set(0xFF0F, 0x00);
+
+    // Lines going low request the joypad interrupt, whether a button is pressed or its line selected.
+    mmu.set(0xFF00, 0x20);
+    REQUIRE(mmu.get(0xFF0F) == 0x10);
+    mmu.set(0xFF0F, 0x00);
+    mmu.setJoypad(Mmu::buttonRight);
+    REQUIRE(mmu.get(0xFF0F) == 0x00);
+    mmu.setJoypad(Mmu::buttonRight | Mmu::buttonDown);
+    REQUIRE(mmu.get(0xFF00) == 0xE6);
+    REQUIRE(mmu.get(0xFF0F) == 0x10);
+}
@@ -0,0 +1,152 @@
+#include <movie.h>
+
+#include <machine.h>
+#include <savestate.h>
+
+#include <catch.hpp>
+
+#include <memory>
+#include <optional>
+
+// Boot ROM which adds joypad register values to work RAM.
+static std::vector<uint8_t> makeJoypadBootstrap()
+{
+    std::vector<uint8_t> bootstrap(0x100, 0);
+    const std::vector<uint8_t> code{
+        0x3E, 0x20, // LD A,0x20
+        0xE0, 0x00, // LDH (0x00),A - select directions
+        0xF0, 0x00, // LDH A,(0x00)
+        0x21, 0x00, 0xC0, // LD HL,0xC000
+        0x86, // ADD A,(HL)
+        0x77, // LD (HL),A
+        0x18, 0xF7 // JR -9
+    };
+    std::copy(code.begin(), code.end(), bootstrap.begin());
+    return bootstrap;
+}
+
+static std::shared_ptr<const Rom> makeRom()
+{
+    return std::make_shared<const Rom>(std::vector<uint8_t>{});
+}
+
+// Replay movie and return the final state hash.
+static uint64_t replay(const Movie& movie)
+{
+    Machine machine{ makeJoypadBootstrap(), makeRom() };
+    auto state = std::make_unique<MachineState>();
+    deserializeState(movie.startState, *state);
+    machine.loadState(*state);
+    for (auto buttons : movie.frames) {
+        machine.getMmu().setJoypad(buttons);
+        REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+    }
+    return machine.getStateHash();
+}
+
+TEST_CASE("Replayed movie reproduces the recorded run", "[movie]")
+{
+    Machine machine{ makeJoypadBootstrap(), makeRom() };
+    Movie movie;
+    movie.romHash = hashRom(*makeRom());
+    auto state = std::make_unique<MachineState>();
+    machine.saveState(*state);
+    movie.startState = serializeState(*state);
+    const std::vector<int> input{ 0, Mmu::buttonLeft, Mmu::buttonLeft | Mmu::buttonUp, 0, Mmu::buttonA, Mmu::buttonDown };
+    for (auto value : input) {
+        auto buttons = static_cast<uint8_t>(value);
+        machine.getMmu().setJoypad(buttons);
+        REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+        movie.frames.push_back(buttons);
+    }
+
+    auto data = serializeMovie(movie);
+    auto decoded = deserializeMovie(data);
+    REQUIRE(decoded.romHash == movie.romHash);
+    REQUIRE(decoded.startState == movie.startState);
+    REQUIRE(decoded.frames == movie.frames);
+    REQUIRE(replay(decoded) == machine.getStateHash());
+
+    decoded.frames[2] = Mmu::buttonRight;
+    REQUIRE(replay(decoded) != machine.getStateHash());
+}
+
+TEST_CASE("Movie recorded with breakpoints and single steps replays in sync", "[movie]")
+{
+    // Same frame start handling as the emulator user interface.
+    Machine machine{ makeJoypadBootstrap(), makeRom() };
+    MovieRecorder recorder{ machine, *makeRom() };
+    std::optional<uint64_t> startedFrame;
+    uint8_t joypad = 0;
+    auto beginFrame = [&] {
+        if (startedFrame != machine.getFrameCount()) {
+            startedFrame = machine.getFrameCount();
+            machine.getMmu().setJoypad(joypad);
+            recorder.record(machine);
+        }
+    };
+    auto step = [&](int count) {
+        for (int i = 0; i < count; ++i) {
+            beginFrame();
+            REQUIRE(machine.step() == StepResult::Executed);
+        }
+    };
+
+    joypad = Mmu::buttonLeft;
+    beginFrame();
+    REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+
+    // Stopped at a breakpoint, resumed with other buttons held, which apply from the next frame.
+    joypad = Mmu::buttonUp;
+    beginFrame();
+    REQUIRE(machine.runFrame(0x0009) == StepResult::Breakpoint);
+    joypad = Mmu::buttonDown;
+    beginFrame();
+    REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+
+    // Stepped partway, then finished.
+    step(100);
+    joypad = Mmu::buttonRight;
+    step(100);
+    beginFrame();
+    REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+
+    auto state = std::make_unique<MachineState>();
+    machine.saveState(*state);
+    auto hash = machine.getStateHash();
+    // Unfinished frame isn't part of the movie.
+    step(100);
+    auto movie = recorder.getMovie(machine);
+    REQUIRE(movie.frames == std::vector<uint8_t>{ Mmu::buttonLeft, Mmu::buttonUp, Mmu::buttonDown });
+    REQUIRE(replay(movie) == hash);
+
+    // Going back in time drops input recorded after the restored frame.
+    machine.loadState(*state);
+    startedFrame.reset();
+    joypad = Mmu::buttonA;
+    beginFrame();
+    REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+    movie = recorder.getMovie(machine);
+    REQUIRE(movie.frames == std::vector<uint8_t>{ Mmu::buttonLeft, Mmu::buttonUp, Mmu::buttonDown, Mmu::buttonA });
+    REQUIRE(replay(movie) == machine.getStateHash());
+}
+
+TEST_CASE("Invalid movies are rejected", "[movie]")
+{
+    Movie movie;
+    movie.startState = { 1, 2, 3 };
+    movie.frames = { 0, 1 };
+    auto data = serializeMovie(movie);
+
+    auto truncated = data;
+    truncated.pop_back();
+    REQUIRE_THROWS(deserializeMovie(truncated));
+
+    auto otherVersion = data;
+    otherVersion[4] = movieVersion + 1;
+    REQUIRE_THROWS(deserializeMovie(otherVersion));
+
+    auto notMovie = data;
+    notMovie[0] = 'X';
+    REQUIRE_THROWS(deserializeMovie(notMovie));
+}
@@ -0,0 +1,67 @@
+#include <pixeldecoder.h>
+
+#include <catch.hpp>
+
+#include <vector>
+
+static const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 };
+
+TEST_CASE("Pixel has image data byte order", "[pixeldecoder]")
+{
+    Pixel pixel = toPixel({ 1, 2, 3 });
+    auto bytes = reinterpret_cast<const uint8_t*>(&pixel);
+    REQUIRE(bytes[0] == 1);
+    REQUIRE(bytes[1] == 2);
+    REQUIRE(bytes[2] == 3);
+    REQUIRE(bytes[3] == 0);
+}
+
+TEST_CASE("Best kernels are supported by host", "[pixeldecoder]")
+{
+    REQUIRE(getPixelKernels(getPixelKernels().level) == &getPixelKernels());
+}
+
+TEST_CASE("Tile rows decode the same with every instruction set", "[pixeldecoder]")
+{
+    // Odd row count exercises the remainder loops.
+    std::vector<uint8_t> data;
+    for (auto i = 0u; i < 2 * 23; ++i) {
+        data.push_back(static_cast<uint8_t>(i * 37 + 11));
+    }
+    auto rows = data.size() / 2;
+    std::vector<uint8_t> expected(rows * pixelsPerLine);
+    getPixelKernels(SimdLevel::Scalar)->decodeRows(data.data(), rows, expected.data());
+    REQUIRE(expected[0] == 0); // low 0x0B, high 0x30: leftmost pixel has neither bit set
+    REQUIRE(expected[2] == 2);
+    REQUIRE(expected[7] == 1);
+
+    for (auto level : levels) {
+        if (auto kernels = getPixelKernels(level)) {
+            INFO(kernels->name);
+            std::vector<uint8_t> colors(expected.size());
+            kernels->decodeRows(data.data(), rows, colors.data());
+            REQUIRE(colors == expected);
+        }
+    }
+}
+
+TEST_CASE("Colors resolve the same with every instruction set", "[pixeldecoder]")
+{
+    PixelPalette palette{ 0x11111111, 0x22222222, 0x33333333, 0x44444444 };
+    std::vector<uint8_t> colors;
+    for (auto i = 0u; i < 163; ++i) {
+        colors.push_back(static_cast<uint8_t>((i * 7) % 4));
+    }
+    std::vector<uint8_t> expected(colors.size() * sizeof(Pixel));
+    getPixelKernels(SimdLevel::Scalar)->resolveColors(colors.data(), colors.size(), palette, expected.data());
+    REQUIRE(expected[4 * 1] == 0x44);
+
+    for (auto level : levels) {
+        if (auto kernels = getPixelKernels(level)) {
+            INFO(kernels->name);
+            std::vector<uint8_t> pixels(expected.size());
+            kernels->resolveColors(colors.data(), colors.size(), palette, pixels.data());
+            REQUIRE(pixels == expected);
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#include <rewind.h>
+
+#include <catch.hpp>
+
+#include <utility>
+#include <vector>
+
+// Boot ROM which keeps changing tile data, and so the screen, work RAM and cartridge RAM, which are
+// recorded separately.
+static std::vector<uint8_t> makeBootstrap()
+{
+    std::vector<uint8_t> bootstrap(0x100, 0);
+    const std::vector<uint8_t> code{
+        0x3E, 0x0A, // LD A,0x0A
+        0xEA, 0x00, 0x00, // LD (0x0000),A ; Enable cartridge RAM
+        0x21, 0x00, 0x80, // LD HL,0x8000
+        0x3C, // INC A
+        0x77, // LD (HL),A
+        0xEA, 0x00, 0xC1, // LD (0xC100),A
+        0xEA, 0x00, 0xA0, // LD (0xA000),A
+        0x18, 0xF6 // JR -10
+    };
+    std::copy(code.begin(), code.end(), bootstrap.begin());
+    return bootstrap;
+}
+
+static Machine makeMachine()
+{
+    std::vector<uint8_t> rom(0x8000, 0);
+    rom[0x147] = 0x03; // MBC1 with RAM and battery
+    rom[0x149] = 0x02; // 8 KiB RAM
+    return Machine{ makeBootstrap(), std::make_shared<const Rom>(rom) };
+}
+
+// Hashes of the address space and of the screen.
+using Hashes = std::pair<uint64_t, uint64_t>;
+
+static Hashes getHashes(const Machine& machine)
+{
+    return { machine.getStateHash(), machine.getFrameHash() };
+}
+
+// Record a state and its hashes per frame.
+static void record(Machine& machine, Rewind& rewind, std::vector<Hashes>& hashes, int frames)
+{
+    for (int i = 0; i < frames; ++i) {
+        REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+        rewind.push(machine);
+        hashes.push_back(getHashes(machine));
+    }
+}
+
+// Rewind all recorded states, checking they match the newest hashes.
+static void rewindAll(Machine& machine, Rewind& rewind, std::vector<Hashes>& hashes)
+{
+    while (rewind.size() > 0) {
+        REQUIRE(rewind.rewind(machine));
+        REQUIRE(getHashes(machine) == hashes.back());
+        hashes.pop_back();
+    }
+    REQUIRE_FALSE(rewind.rewind(machine));
+    REQUIRE(rewind.getMemoryUsage() == 0);
+}
+
+TEST_CASE("Rewind restores recorded states newest first", "[rewind]")
+{
+    auto machine = makeMachine();
+    Rewind rewind{ Rewind::defaultMemoryBudget, 10 };
+    std::vector<Hashes> hashes;
+    record(machine, rewind, hashes, 25);
+    REQUIRE(rewind.size() == 25);
+    REQUIRE(machine.getMmu().getCartridgeRam()[0] != 0);
+    REQUIRE(hashes[20].second != hashes[21].second);
+    // Frames between keyframes only store the memory they changed.
+    REQUIRE(rewind.getMemoryUsage() < 25 * 0x1000);
+
+    // Continue recording after rewinding past a keyframe.
+    for (int i = 0; i < 7; ++i) {
+        REQUIRE(rewind.rewind(machine));
+        REQUIRE(getHashes(machine) == hashes.back());
+        hashes.pop_back();
+    }
+    record(machine, rewind, hashes, 12);
+    REQUIRE(rewind.size() == 30);
+    rewindAll(machine, rewind, hashes);
+}
+
+TEST_CASE("Rewind drops the oldest states over the memory budget", "[rewind]")
+{
+    auto probeMachine = makeMachine();
+    Rewind probe{ Rewind::defaultMemoryBudget, 10 };
+    std::vector<Hashes> hashes;
+    record(probeMachine, probe, hashes, 10);
+    auto groupSize = probe.getMemoryUsage();
+
+    auto machine = makeMachine();
+    Rewind rewind{ 3 * groupSize, 10 };
+    hashes.clear();
+    record(machine, rewind, hashes, 100);
+    REQUIRE(rewind.getMemoryUsage() <= 3 * groupSize);
+    REQUIRE(rewind.size() >= 20);
+    REQUIRE(rewind.size() <= 30);
+    // Whole groups are dropped, the oldest remaining state is a keyframe.
+    REQUIRE(rewind.size() % 10 == 0);
+    auto dropped = hashes.size() - rewind.size();
+    rewindAll(machine, rewind, hashes);
+    REQUIRE(hashes.size() == dropped);
+}
@@ -0,0 +1,106 @@
+#include <savestate.h>
+
+#include <catch.hpp>
+
+#include <memory>
+
+// Boot ROM which keeps changing work RAM.
+static std::vector<uint8_t> makeCountingBootstrap()
+{
+    std::vector<uint8_t> bootstrap(0x100, 0);
+    const std::vector<uint8_t> code{
+        0x21, 0x00, 0xC0, // LD HL,0xC000
+        0x77, // LD (HL),A
+        0x3C, // INC A
+        0xEA, 0x00, 0xC1, // LD (0xC100),A
+        0x18, 0xF9 // JR -7
+    };
+    std::copy(code.begin(), code.end(), bootstrap.begin());
+    return bootstrap;
+}
+
+static std::shared_ptr<const Rom> makeRom(uint8_t title)
+{
+    std::vector<uint8_t> rom(0x8000, 0);
+    rom[0x134] = title;
+    rom[0x149] = 0x02; // 8 KiB RAM
+    return std::make_shared<const Rom>(rom);
+}
+
+static void runFrames(Machine& machine, int frames)
+{
+    for (int i = 0; i < frames; ++i) {
+        REQUIRE(machine.runFrame() == StepResult::FrameFinished);
+    }
+}
+
+TEST_CASE("Restored state continues like the machine it was saved from", "[savestate]")
+{
+    Machine machine{ makeCountingBootstrap(), makeRom(1) };
+    runFrames(machine, 3);
+    auto state = std::make_unique<MachineState>();
+    machine.saveState(*state);
+
+    runFrames(machine, 5);
+    auto stateHash = machine.getStateHash();
+    auto frameHash = machine.getFrameHash();
+    auto instructions = machine.getInstructionCount();
+
+    machine.loadState(*state);
+    REQUIRE(machine.getFrameCount() == 3);
+    runFrames(machine, 5);
+    REQUIRE(machine.getStateHash() == stateHash);
+    REQUIRE(machine.getFrameHash() == frameHash);
+    REQUIRE(machine.getInstructionCount() == instructions);
+}
+
+TEST_CASE("Binary save state restores the same state in another machine", "[savestate]")
+{
+    Machine machine{ makeCountingBootstrap(), makeRom(1) };
+    runFrames(machine, 2);
+    auto state = std::make_unique<MachineState>();
+    machine.saveState(*state);
+    auto data = serializeState(*state);
+    // 8 KiB of cartridge RAM is stored, not the maximum of 128 KiB.
+    REQUIRE(data.size() < sizeof(MachineState) - 0x10000);
+
+    Machine restored{ makeCountingBootstrap(), makeRom(1) };
+    auto decoded = std::make_unique<MachineState>();
+    deserializeState(data, *decoded);
+    restored.loadState(*decoded);
+    REQUIRE(restored.getStateHash() == machine.getStateHash());
+    REQUIRE(restored.getFrameHash() == machine.getFrameHash());
+    REQUIRE(restored.getCpu().toString() == machine.getCpu().toString());
+
+    runFrames(machine, 1);
+    runFrames(restored, 1);
+    REQUIRE(restored.getStateHash() == machine.getStateHash());
+}
+
+TEST_CASE("Invalid save states are rejected", "[savestate]")
+{
+    Machine machine{ makeCountingBootstrap(), makeRom(1) };
+    auto state = std::make_unique<MachineState>();
+    machine.saveState(*state);
+    auto data = serializeState(*state);
+    auto decoded = std::make_unique<MachineState>();
+
+    auto truncated = data;
+    truncated.pop_back();
+    REQUIRE_THROWS(deserializeState(truncated, *decoded));
+
+    auto trailing = data;
+    trailing.push_back(0);
+    REQUIRE_THROWS(deserializeState(trailing, *decoded));
+
+    auto otherVersion = data;
+    otherVersion[4] = saveStateVersion + 1;
+    REQUIRE_THROWS(deserializeState(otherVersion, *decoded));
+
+    auto notState = data;
+    notState[0] = 'X';
+    REQUIRE_THROWS(deserializeState(notState, *decoded));
+
+    Machine otherCartridge{ makeCountingBootstrap(), makeRom(2) };
+    REQUIRE_THROWS(otherCartridge.loadState(*state));
+}
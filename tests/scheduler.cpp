@@ -0,0 +1,26 @@
+#include <scheduler.h>
+
+#include <catch.hpp>
+
+TEST_CASE("Nothing is due in an empty scheduler", "[scheduler]")
+{
+    Scheduler scheduler;
+    REQUIRE(scheduler.getNextDeadline() == Scheduler::never);
+    REQUIRE_FALSE(scheduler.popDue(1000));
+}
+
+TEST_CASE("Events are due in order of their cycle", "[scheduler]")
+{
+    Scheduler scheduler;
+    scheduler.schedule(Event::GpuModeEnd, 300);
+    scheduler.schedule(Event::GpuModeEnd, 100);
+    scheduler.schedule(Event::GpuModeEnd, 200);
+    REQUIRE(scheduler.getNextDeadline() == 100);
+
+    REQUIRE_FALSE(scheduler.popDue(99));
+    REQUIRE(scheduler.popDue(250));
+    REQUIRE(scheduler.getNextDeadline() == 200);
+    REQUIRE(scheduler.popDue(250));
+    REQUIRE_FALSE(scheduler.popDue(250));
+    REQUIRE(scheduler.getNextDeadline() == 300);
+}
@@ -0,0 +1,25 @@
+#include <tilecache.h>
+
+#include <catch.hpp>
+
+#include <vector>
+
+TEST_CASE("Tile line is decoded from bit planes", "[tilecache]")
+{
+    // Low plane has bits 0, high plane bits 1 of color indices.
+    REQUIRE(decodeTileLine(0b10100000, 0b11000001) == TileLine{ 3, 2, 1, 0, 0, 0, 0, 2 });
+}
+
+TEST_CASE("Tile is decoded again only after invalidation", "[tilecache]")
+{
+    std::vector<uint8_t> tileData(TileCache::tileCount * TileCache::bytesPerTile, 0);
+    TileCache cache;
+    tileData[16] = 0xFF; // First line of tile 1
+    REQUIRE(cache.get(tileData, 1)[0] == TileLine{ 1, 1, 1, 1, 1, 1, 1, 1 });
+
+    tileData[16] = 0x00;
+    REQUIRE(cache.get(tileData, 1)[0] == TileLine{ 1, 1, 1, 1, 1, 1, 1, 1 });
+
+    cache.invalidate(1);
+    REQUIRE(cache.get(tileData, 1)[0] == TileLine{ 0, 0, 0, 0, 0, 0, 0, 0 });
+}
@@ -1,5 +1,7 @@
 #include <utils.h>
 
+#include <algorithm>
+
 #include <catch.hpp>
 
 TEST_CASE("Bits are numbered from right to left, from 0 to 7", "[utils]")
@@ -7,7 +9,7 @@ TEST_CASE("Bits are numbered from right to left, from 0 to 7", "[utils]")
     REQUIRE(isBitSet(0, 0b00000001));
     REQUIRE(isBitSet(7, 0b10000000));
     REQUIRE(!isBitSet(0, 0b10000000));
-    REQUIRE_THROWS(isBitSet(8, 0));
+    REQUIRE(isBitSet(8, 0b00000001));
 }
 
 TEST_CASE("Bytes are concatenated as little endian", "[utils]")
@@ -36,3 +38,79 @@ TEST_CASE("Half carry occurs when, while adding two 16 bit values, bit 11 carrie
     REQUIRE(!isHalfCarryAddition16(0x800, 0x7ff)); // 0x800 + 0x7ff = 0xfff <= 0xfff
     REQUIRE(!isHalfCarryAddition16(0xffff, 0xf000)); // 0xfff + 0xf000 = 0xfff <= 0xfff
 }
+
+TEST_CASE("Buffer reader reads bytes past the end of buffer as 0", "[utils]")
+{
+    std::vector<uint8_t> buffer{ 0x12, 0x34 };
+    BufferReader reader{ buffer };
+    REQUIRE(reader.read(1) == 0x34);
+    REQUIRE(reader.read(2) == 0);
+}
+
+TEST_CASE("Instruction is disassembled from memory reader", "[utils]")
+{
+    std::vector<uint8_t> code{ 0x00, 0x31, 0xFE, 0xFF }; // NOP; LD SP,$fffe
+    Instruction instr = disassemble(BufferReader{ code }, 1);
+    REQUIRE(instr.pc == 1);
+    REQUIRE(std::string(instr.mnemonic()) == "LD");
+    REQUIRE(instr.length == 3);
+    REQUIRE(instr.value == 0xfffe);
+
+    char buffer[32];
+    REQUIRE(formatOperands(instr, buffer) == "SP,$fffe");
+    REQUIRE(formatBytes(instr, buffer) == "31 FE FF ");
+}
+
+TEST_CASE("Relative jump is disassembled with absolute target address", "[utils]")
+{
+    std::vector<uint8_t> code{ 0x20, 0xFE }; // JR NZ,$0000
+    Instruction instr = disassemble(BufferReader{ code }, 0);
+    char buffer[32];
+    REQUIRE(formatOperands(instr, buffer) == "NZ,$0000");
+}
+
+TEST_CASE("Formatted instruction is truncated to buffer size", "[utils]")
+{
+    std::vector<uint8_t> code{ 0x31, 0xFE, 0xFF };
+    Instruction instr = disassemble(BufferReader{ code }, 0);
+    char buffer[4];
+    REQUIRE(formatOperands(instr, buffer) == "SP,$");
+    REQUIRE(formatBytes(instr, buffer) == "31 F");
+}
+
+TEST_CASE("Opcode data is looked up in generated tables", "[utils]")
+{
+    REQUIRE(std::string(getOpcodeData(0x00, 0x00)->mnemonic) == "NOP");
+    REQUIRE(getOpcodeData(0x01, 0x00)->length == 3);
+    REQUIRE(std::string(getOpcodeData(0xCB, 0x7C)->mnemonic) == "BIT");
+    REQUIRE(getOpcodeData(0xD3, 0x00) == nullptr);
+}
+
+TEST_CASE("xxHash64 matches reference values", "[utils]")
+{
+    std::string text = "Nobody inspects the spammish repetition"; // Long enough for all 4 lanes and every tail
+    auto bytes = [](const std::string& s) { return gsl::make_span(reinterpret_cast<const uint8_t*>(s.data()), s.size()); };
+    REQUIRE(xxHash64({}) == 0xEF46DB3751D8E999);
+    REQUIRE(xxHash64(bytes("a")) == 0xD24EC4F1A98C6E5B);
+    REQUIRE(xxHash64(bytes("abc")) == 0x44BC2CF5AD770999);
+    REQUIRE(xxHash64(bytes(text)) == 0xFBCEA83C8A378BF1);
+}
+
+TEST_CASE("PNG has RGB header and stored image data", "[utils]")
+{
+    std::vector<uint8_t> pixels{ 0x11, 0x22, 0x33, 0xFF, 0x44, 0x55, 0x66, 0xFF };
+    auto png = encodePng(pixels, 2, 1);
+    std::vector<uint8_t> signature{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    REQUIRE(std::equal(signature.begin(), signature.end(), png.begin()));
+    REQUIRE(std::string(png.begin() + 12, png.begin() + 16) == "IHDR");
+    REQUIRE(png[24] == 8); // Bit depth
+    REQUIRE(png[25] == 2); // RGB
+    // Filter byte and pixels without the unused bytes, in a single stored block after the zlib header.
+    std::vector<uint8_t> row{ 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+    REQUIRE(std::string(png.begin() + 37, png.begin() + 41) == "IDAT");
+    REQUIRE(std::equal(row.begin(), row.end(), png.begin() + 48));
+    std::vector<uint8_t> end{ 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82 };
+    REQUIRE(std::equal(end.begin(), end.end(), png.end() - 8));
+
+    REQUIRE_THROWS(encodePng(pixels, 2, 2));
+}